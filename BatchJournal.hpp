@@ -0,0 +1,170 @@
+#ifndef BATCHJOURNAL_H
+#define BATCHJOURNAL_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <cstdio>
+
+using namespace std;
+
+// 批处理的重做日志。提交时先把这一批要写入各文件的全部内容（文件名、偏移、字节）写进日志，
+// 再写各个文件，都成功后删除日志。打开时日志若完整（末尾校验通过）就把其中的写入重做一遍，
+// 不完整说明提交在写日志时中断、各文件还没有改动，直接丢弃。重做须在各数据库打开文件之前完成
+class BatchJournal {
+private:
+    struct FileWrite {
+        string file;
+        long long offset;
+        string bytes;
+    };
+
+    static const unsigned long long MAGIC = 0x4c4e524a48435442ULL;
+
+    string filename;
+    vector<FileWrite> writes;
+    bool replay_failed;
+
+    // FNV-1a
+    static unsigned long long checksum(const string& data, size_t size) {
+        unsigned long long h = 1469598103934665603ULL;
+        for (size_t i = 0; i < size; i++) {
+            h ^= (unsigned char)data[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    template <class T>
+    static void put(string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <class T>
+    static bool get(const string& in, size_t& pos, size_t end, T& value) {
+        if (end - pos < sizeof(T)) return false;
+        in.copy(reinterpret_cast<char*>(&value), sizeof(T), pos);
+        pos += sizeof(T);
+        return true;
+    }
+
+    // 依次执行各次写入，同一文件的相邻写入共用一个文件流
+    static bool apply(const vector<FileWrite>& list) {
+        bool success = true;
+        fstream out;
+        string current;
+        for (const auto& write : list) {
+            if (!out.is_open() || write.file != current) {
+                if (out.is_open()) {
+                    out.flush();
+                    success = success && out.good();
+                    out.close();
+                }
+                {
+                    ifstream test(write.file);
+                    if (!test.good()) {
+                        ofstream create(write.file, ios::binary);
+                    }
+                }
+                out.open(write.file, ios::in | ios::out | ios::binary);
+                current = write.file;
+            }
+            out.seekp(write.offset);
+            out.write(write.bytes.data(), write.bytes.size());
+            success = success && out.good();
+        }
+        if (out.is_open()) {
+            out.flush();
+            success = success && out.good();
+        }
+        return success;
+    }
+
+    // 读出完整的日志；不存在或不完整时返回 false
+    bool load(vector<FileWrite>& list) {
+        ifstream in(filename, ios::binary);
+        if (!in.good()) return false;
+        string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        const size_t trailer = sizeof(unsigned long long) * 3;
+        if (data.size() < trailer) return false;
+        size_t body = data.size() - trailer;
+        size_t pos = body;
+        unsigned long long count = 0, sum = 0, magic = 0;
+        get(data, pos, data.size(), count);
+        get(data, pos, data.size(), sum);
+        get(data, pos, data.size(), magic);
+        if (magic != MAGIC || sum != checksum(data, body)) return false;
+        pos = 0;
+        for (unsigned long long i = 0; i < count; i++) {
+            FileWrite write;
+            unsigned int name_size = 0;
+            unsigned long long size = 0;
+            if (!get(data, pos, body, name_size) || body - pos < name_size) return false;
+            write.file = data.substr(pos, name_size);
+            pos += name_size;
+            if (!get(data, pos, body, write.offset) || !get(data, pos, body, size) || body - pos < size) return false;
+            write.bytes = data.substr(pos, (size_t)size);
+            pos += (size_t)size;
+            list.push_back(write);
+        }
+        return pos == body;
+    }
+
+public:
+    explicit BatchJournal(const string& fname) : filename(fname), replay_failed(false) {
+        vector<FileWrite> list;
+        if (load(list) && !apply(list)) {
+            // 重做失败时保留日志，下次打开再试
+            replay_failed = true;
+            return;
+        }
+        std::remove(filename.c_str());
+    }
+
+    // 打开时是否有完整的日志没能重做，此时各文件可能只写了一部分
+    bool failed() const { return replay_failed; }
+
+    // 记下一次写入，write() 时才写进日志
+    void add(const string& file, long long offset, const char* data, size_t size) {
+        FileWrite write;
+        write.file = file;
+        write.offset = offset;
+        write.bytes.assign(data, size);
+        writes.push_back(write);
+    }
+
+    // 把记下的写入连同校验一次写进日志文件并刷新，失败时不留下日志
+    bool write() {
+        string data;
+        for (const auto& entry : writes) {
+            put(data, (unsigned int)entry.file.size());
+            data += entry.file;
+            put(data, entry.offset);
+            put(data, (unsigned long long)entry.bytes.size());
+            data += entry.bytes;
+        }
+        unsigned long long sum = checksum(data, data.size());
+        put(data, (unsigned long long)writes.size());
+        put(data, sum);
+        put(data, MAGIC);
+        ofstream out(filename, ios::binary | ios::trunc);
+        out.write(data.data(), data.size());
+        out.flush();
+        if (!out.good()) {
+            out.close();
+            clear();
+            return false;
+        }
+        writes.clear();
+        return true;
+    }
+
+    // 各文件都已写好：删除日志
+    void clear() {
+        writes.clear();
+        std::remove(filename.c_str());
+    }
+};
+
+#endif // BATCHJOURNAL_H
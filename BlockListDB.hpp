@@ -9,6 +9,8 @@
 #include <cstring>
 #include <sstream>
 #include <map>
+#include "BatchJournal.hpp"
+#include "ThreadPool.hpp"
 
 using namespace std;
 
@@ -82,53 +84,76 @@ struct BlockIndexEntry {
 
 class BlockListDB {
 private:
+    static const size_t PARALLEL_MIN_BLOCKS = 16;
+    static const int BLOCK_BYTES = sizeof(int) * 2 + INDEX_SIZE * 2 + sizeof(Record) * BLOCK_SIZE;
+
     string filename;
     fstream data_file;
     int first_block_offset;
     vector<BlockIndexEntry> block_index;
 
-    bool linear_find_position(const string& key, int& found_block_offset, int& found_record_index) {
-        for (const auto& entry : block_index) {
-            if (entry.block_offset == -1) continue;
-            Block block = read_block(entry.block_offset);
-            for (int i = 0; i < block.record_count; i++) {
-                if (strcmp(block.records[i].index, key.c_str()) == 0) {
-                    found_block_offset = entry.block_offset;
-                    found_record_index = i;
-                    return true;
-                }
-            }
-        }
-        return false;
-    }
+    // 批处理：期间写入的块只留在内存中，提交时一起写回，放弃时丢弃并恢复开始时的块链
+    bool batching;
+    map<int, Block> dirty_blocks;
+    int batch_end;                          // 含尚未写出的新块在内的文件末尾
+    int saved_first_block;
+    vector<BlockIndexEntry> saved_index;
 
     Block read_block(int offset) {
+        return read_block(data_file, offset);
+    }
+
+    // 从给定的文件流读取；并行扫描时每段用自己的流
+    Block read_block(istream& in, int offset) const {
         Block block;
         if (offset < 0) return block;
+        if (batching) {
+            auto it = dirty_blocks.find(offset);
+            if (it != dirty_blocks.end()) return it->second;
+        }
 
-        data_file.clear();
-        data_file.seekg(offset);
-        data_file.read(reinterpret_cast<char*>(&block.record_count), sizeof(int));
-        data_file.read(reinterpret_cast<char*>(&block.next_block), sizeof(int));
-        data_file.read(block.first_index, INDEX_SIZE);
-        data_file.read(block.last_index, INDEX_SIZE);
-        data_file.read(reinterpret_cast<char*>(block.records), sizeof(Record) * BLOCK_SIZE);
+        in.clear();
+        in.seekg(offset);
+        in.read(reinterpret_cast<char*>(&block.record_count), sizeof(int));
+        in.read(reinterpret_cast<char*>(&block.next_block), sizeof(int));
+        in.read(block.first_index, INDEX_SIZE);
+        in.read(block.last_index, INDEX_SIZE);
+        in.read(reinterpret_cast<char*>(block.records), sizeof(Record) * BLOCK_SIZE);
 
         return block;
     }
 
     void write_block(int offset, const Block& block) {
+        if (batching) {
+            dirty_blocks[offset] = block;
+            batch_end = max(batch_end, offset + BLOCK_BYTES);
+            return;
+        }
+        store_block(offset, block);
+        data_file.flush();
+    }
+
+    void store_block(int offset, const Block& block) {
+        string bytes = block_bytes(block);
         data_file.clear();
         data_file.seekp(offset);
-        data_file.write(reinterpret_cast<const char*>(&block.record_count), sizeof(int));
-        data_file.write(reinterpret_cast<const char*>(&block.next_block), sizeof(int));
-        data_file.write(block.first_index, INDEX_SIZE);
-        data_file.write(block.last_index, INDEX_SIZE);
-        data_file.write(reinterpret_cast<const char*>(block.records), sizeof(Record) * BLOCK_SIZE);
-        data_file.flush();
+        data_file.write(bytes.data(), bytes.size());
+    }
+
+    // 块在文件中的字节内容
+    static string block_bytes(const Block& block) {
+        string bytes;
+        bytes.reserve(BLOCK_BYTES);
+        bytes.append(reinterpret_cast<const char*>(&block.record_count), sizeof(int));
+        bytes.append(reinterpret_cast<const char*>(&block.next_block), sizeof(int));
+        bytes.append(block.first_index, INDEX_SIZE);
+        bytes.append(block.last_index, INDEX_SIZE);
+        bytes.append(reinterpret_cast<const char*>(block.records), sizeof(Record) * BLOCK_SIZE);
+        return bytes;
     }
 
     int get_end_position() {
+        if (batching) return batch_end;
         data_file.clear();
         data_file.seekg(0, ios::end);
         return data_file.tellg();
@@ -149,6 +174,8 @@ private:
     void load_block_index() {
         block_index.clear();
         int current_offset = first_block_offset;
+        bool sorted = true;
+        string previous;
 
         while (current_offset != -1) {
             Block block = read_block(current_offset);
@@ -157,11 +184,89 @@ private:
             strcpy(entry.first_index, block.first_index);
             strcpy(entry.last_index, block.last_index);
             block_index.push_back(entry);
+            for (int i = 0; i < block.record_count; i++) {
+                if (!previous.empty() && strcmp(previous.c_str(), block.records[i].index) >= 0) sorted = false;
+                previous = block.records[i].index;
+            }
             current_offset = block.next_block;
         }
+        // 旧版本插入时会把记录放进遇到的第一个空块，链上的块可能不按键排序，键也可能重复。
+        // 二分查找依赖整条链严格有序，不满足时先重排一次
+        if (!sorted) {
+            rebuild_sorted();
+            return;
+        }
+        // 旧版本可能留下空块，摘除后索引中的块首尾键严格递增
+        for (int i = (int)block_index.size() - 1; i >= 0 && block_index.size() > 1; i--) {
+            if (block_index[i].first_index[0] == '\0') unlink_block(i);
+        }
+    }
+
+    // 按键排序链上的全部记录（重复的键保留链上靠前的一条），写成文件末尾的一条新链，
+    // 最后才改写元数据指向新链，中途中断时旧链仍然完整。旧链的块空间不回收
+    void rebuild_sorted() {
+        vector<Record> records;
+        for (const auto& entry : block_index) {
+            Block block = read_block(entry.block_offset);
+            records.insert(records.end(), block.records, block.records + block.record_count);
+        }
+        stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+            return strcmp(a.index, b.index) < 0;
+        });
+        records.erase(unique(records.begin(), records.end(), [](const Record& a, const Record& b) {
+            return strcmp(a.index, b.index) == 0;
+        }), records.end());
+
+        const size_t per_block = BLOCK_SIZE - 1;
+        size_t blocks = max((size_t)1, (records.size() + per_block - 1) / per_block);
+        int start = get_end_position();
+        for (size_t k = 0; k < blocks; k++) {
+            Block block;
+            size_t from = k * per_block;
+            size_t to = min(records.size(), from + per_block);
+            for (size_t i = from; i < to; i++) block.records[block.record_count++] = records[i];
+            block.update_boundaries();
+            block.next_block = k + 1 < blocks ? start + (int)(k + 1) * BLOCK_BYTES : -1;
+            store_block(start + (int)k * BLOCK_BYTES, block);
+        }
+        data_file.flush();
+        first_block_offset = start;
+        save_metadata();
+        data_file.flush();
+        load_block_index();
+    }
+
+    // 将第 idx 个块从链表中摘除（至少保留一个块），块空间不回收
+    void unlink_block(int idx) {
+        int next_offset = idx + 1 < (int)block_index.size() ? block_index[idx + 1].block_offset : -1;
+        if (idx == 0) {
+            first_block_offset = next_offset;
+            save_metadata();
+        } else {
+            int prev_offset = block_index[idx - 1].block_offset;
+            Block prev = read_block(prev_offset);
+            prev.next_block = next_offset;
+            write_block(prev_offset, prev);
+        }
+        block_index.erase(block_index.begin() + idx);
+    }
+
+    // 第一个 last_index >= key 的块在 block_index 中的下标，不存在时返回 size()
+    int lower_block(const char* key) const {
+        int left = 0, right = (int)block_index.size();
+        while (left < right) {
+            int mid = left + (right - left) / 2;
+            if (strcmp(block_index[mid].last_index, key) < 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        return left;
     }
 
     void save_metadata() {
+        if (batching) return;   // 提交时写入
         data_file.clear();
         data_file.seekp(0);
         data_file.write(reinterpret_cast<const char*>(&first_block_offset), sizeof(int));
@@ -242,62 +347,33 @@ private:
 
     int find_block_for_insert(const string& index) {
         if (block_index.empty()) return first_block_offset;
-
-        for (const auto& entry : block_index) {
-            if (entry.block_offset == -1) continue;
-            Block block = read_block(entry.block_offset);
-
-            if (block.record_count == 0) {
-                return entry.block_offset;
-            }
-
-            if (strcmp(index.c_str(), entry.last_index) <= 0 || (block.next_block == -1)) {
-                return entry.block_offset;
-            }
-        }
-
-        return block_index.back().block_offset;
+        int idx = lower_block(index.c_str());
+        if (idx == (int)block_index.size()) idx--;
+        return block_index[idx].block_offset;
     }
 
     vector<pair<int, int>> find_record_positions(const string& index) {
         vector<pair<int, int>> positions;
 
-        for (const auto& entry : block_index) {
-            if (entry.block_offset == -1) continue;
-            if (strcmp(index.c_str(), entry.first_index) < 0) {
-                break;
-            }
-            if (strcmp(index.c_str(), entry.last_index) > 0) {
-                continue;
-            }
-
-            Block block = read_block(entry.block_offset);
-
-            int left = 0, right = block.record_count - 1;
-            int first_pos = -1;
+        // 块按键有序且键唯一，记录只可能位于第一个 last_index >= index 的块中
+        int idx = lower_block(index.c_str());
+        if (idx == (int)block_index.size()) return positions;
+        const BlockIndexEntry& entry = block_index[idx];
+        if (strcmp(index.c_str(), entry.first_index) < 0) return positions;
 
-            while (left <= right) {
-                int mid = left + (right - left) / 2;
-                int cmp = strcmp(block.records[mid].index, index.c_str());
-
-                if (cmp == 0) {
-                    first_pos = mid;
-                    right = mid - 1;
-                } else if (cmp < 0) {
-                    left = mid + 1;
-                } else {
-                    right = mid - 1;
-                }
+        Block block = read_block(entry.block_offset);
+        int left = 0, right = block.record_count - 1;
+        while (left <= right) {
+            int mid = left + (right - left) / 2;
+            int cmp = strcmp(block.records[mid].index, index.c_str());
+            if (cmp == 0) {
+                positions.push_back({entry.block_offset, mid});
+                break;
             }
-
-            if (first_pos != -1) {
-                for (int i = first_pos; i < block.record_count; i++) {
-                    if (strcmp(block.records[i].index, index.c_str()) == 0) {
-                        positions.push_back({entry.block_offset, i});
-                    } else {
-                        break;
-                    }
-                }
+            if (cmp < 0) {
+                left = mid + 1;
+            } else {
+                right = mid - 1;
             }
         }
 
@@ -305,7 +381,8 @@ private:
     }
 
 public:
-    BlockListDB(const string& fname) : filename(fname), first_block_offset(-1) {
+    BlockListDB(const string& fname)
+        : filename(fname), first_block_offset(-1), batching(false), batch_end(0), saved_first_block(-1) {
         bool data_exists = false;
         ifstream test(filename);
         if (test.good()) {
@@ -333,16 +410,12 @@ public:
     }
 
     bool insert(const string& key, const string& value) {
-        // 检查键是否已存在（书店系统中键应该是唯一的）
-        if (!find(key).empty()) {
-            return false;
-        }
-
         Record new_record(key, value);
 
         int block_offset = find_block_for_insert(key);
         Block block = read_block(block_offset);
 
+        // 键已存在（书店系统中键应该是唯一的）
         int pos = find_insert_position(block, key);
         if (pos == -1) {
             return false;
@@ -388,16 +461,9 @@ public:
     bool remove(const string& key) {
         auto positions = find_record_positions(key);
         if (positions.empty()) {
-            int block_offset = -1, record_index = -1;
-            if (!linear_find_position(key, block_offset, record_index)) {
-                return false;
-            }
-            positions.push_back({block_offset, record_index});
+            return false;
         }
 
-        // 从后往前删除，避免索引变化
-        sort(positions.rbegin(), positions.rend());
-
         for (const auto& pos : positions) {
             int block_offset = pos.first;
             int record_index = pos.second;
@@ -411,10 +477,13 @@ public:
             block.update_boundaries();
             write_block(block_offset, block);
 
-            for (auto& entry : block_index) {
-                if (entry.block_offset == block_offset) {
-                    strcpy(entry.first_index, block.first_index);
-                    strcpy(entry.last_index, block.last_index);
+            for (int i = 0; i < (int)block_index.size(); i++) {
+                if (block_index[i].block_offset == block_offset) {
+                    strcpy(block_index[i].first_index, block.first_index);
+                    strcpy(block_index[i].last_index, block.last_index);
+                    if (block.record_count == 0 && block_index.size() > 1) {
+                        unlink_block(i);
+                    }
                     break;
                 }
             }
@@ -426,11 +495,7 @@ public:
     string find(const string& key) {
         auto positions = find_record_positions(key);
         if (positions.empty()) {
-            int block_offset = -1, record_index = -1;
-            if (!linear_find_position(key, block_offset, record_index)) {
-                return "";
-            }
-            positions.push_back({block_offset, record_index});
+            return "";
         }
         int block_offset = positions[0].first;
         int record_index = positions[0].second;
@@ -458,29 +523,121 @@ public:
 
     vector<pair<string, string>> find_prefix(const string& prefix) {
         vector<pair<string, string>> result;
+        scan_prefix(prefix, [&](const Record& record) {
+            result.push_back(make_pair(record.get_index(), record.get_value()));
+            return true;
+        });
+        return result;
+    }
 
-        for (const auto& entry : block_index) {
-            if (entry.block_offset == -1) continue;
+    // 并行扫描以 prefix 开头的记录，供愿意按段合并部分结果的报表、统计调用；find_prefix/find_all 仍是顺序扫描。
+    // 把涉及的块按块索引顺序分成至多 parts 段，每段至少 PARALLEL_MIN_BLOCKS 块，各段由 run_parallel 交给共用的
+    // 扫描线程，用独立的文件流按键升序调用 visit(段号, 记录)，visit 返回 false 时该段提前结束。
+    // 段号小的段键也小，按段号合并各段的部分结果即保持键序。返回实际的段数。扫描期间不能有写入
+    template <class Visitor>
+    size_t parallel_scan(const string& prefix, size_t parts, Visitor visit) {
+        size_t len = prefix.length();
+        int first = lower_block(prefix.c_str());
+        int last = first;
+        while (last < (int)block_index.size() && strncmp(block_index[last].first_index, prefix.c_str(), len) <= 0) {
+            last++;
+        }
+        size_t blocks = last - first;
+        parts = max<size_t>(1, min(parts, blocks / PARALLEL_MIN_BLOCKS));
+        run_parallel(parts, [&](size_t part) {
+            ifstream in(filename, ios::binary);
+            int from = (int)part_begin(first, last, part, parts);
+            int to = (int)part_begin(first, last, part + 1, parts);
+            for (int idx = from; idx < to; idx++) {
+                Block block = read_block(in, block_index[idx].block_offset);
+                for (int i = 0; i < block.record_count; i++) {
+                    if (strncmp(block.records[i].index, prefix.c_str(), len) != 0) continue;
+                    if (!visit(part, block.records[i])) return;
+                }
+            }
+        });
+        return parts;
+    }
+
+    // 按键升序依次访问以 prefix 开头的记录，visit 返回 false 时提前结束
+    template <class Visitor>
+    void scan_prefix(const string& prefix, Visitor visit) {
+        scan_from(prefix, prefix, visit);
+    }
+
+    // 同 scan_prefix，但从第一个键 >= start 的记录开始
+    template <class Visitor>
+    void scan_from(const string& start, const string& prefix, Visitor visit) {
+        size_t len = prefix.length();
+        for (int idx = lower_block(start.c_str()); idx < (int)block_index.size(); idx++) {
+            const BlockIndexEntry& entry = block_index[idx];
+            if (strncmp(entry.first_index, prefix.c_str(), len) > 0) return;
 
             Block block = read_block(entry.block_offset);
             for (int i = 0; i < block.record_count; i++) {
-                if (strncmp(block.records[i].index, prefix.c_str(), prefix.length()) == 0) {
-                    result.push_back(make_pair(
-                            block.records[i].get_index(),
-                            block.records[i].get_value()
-                    ));
-                }
+                if (strcmp(block.records[i].index, start.c_str()) < 0) continue;
+                int cmp = strncmp(block.records[i].index, prefix.c_str(), len);
+                if (cmp < 0) continue;
+                if (cmp > 0) return;
+                if (!visit(block.records[i])) return;
             }
         }
+    }
 
-        return result;
+    void begin_batch() {
+        if (batching) return;
+        batch_end = get_end_position();
+        saved_first_block = first_block_offset;
+        saved_index = block_index;
+        batching = true;
     }
 
+    // 把 commit_batch() 将要写入的块与元数据记进 journal，不改动文件
+    void journal_batch(BatchJournal& journal) const {
+        if (!batching) return;
+        for (const auto& entry : dirty_blocks) {
+            string bytes = block_bytes(entry.second);
+            journal.add(filename, entry.first, bytes.data(), bytes.size());
+        }
+        journal.add(filename, 0, reinterpret_cast<const char*>(&first_block_offset), sizeof(int));
+    }
+
+    // 按偏移顺序写回批处理中改过的块，最后只刷新一次；返回是否全部写成功
+    bool commit_batch() {
+        if (!batching) return true;
+        batching = false;
+        bool success = true;
+        for (const auto& entry : dirty_blocks) {
+            store_block(entry.first, entry.second);
+            success = success && data_file.good();
+        }
+        save_metadata();
+        data_file.flush();
+        success = success && data_file.good();
+        dirty_blocks.clear();
+        saved_index.clear();
+        return success;
+    }
+
+    void abort_batch() {
+        if (!batching) return;
+        batching = false;
+        dirty_blocks.clear();
+        first_block_offset = saved_first_block;
+        block_index.swap(saved_index);
+        saved_index.clear();
+    }
+
+    // 键已存在时在所在块中原地改写值，只写这一个块
     bool insert_or_update(const string& key, const string& value) {
-        if (!find(key).empty()) {
-            return update(key, value);
+        auto positions = find_record_positions(key);
+        if (positions.empty()) {
+            return insert(key, value);
         }
-        return insert(key, value);
+        Block block = read_block(positions[0].first);
+        block.records[positions[0].second] = Record(key, value);
+        write_block(positions[0].first, block);
+        return true;
     }
 };
 
@@ -0,0 +1,160 @@
+#ifndef COMMANDPIPELINE_H
+#define COMMANDPIPELINE_H
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include "command.h"
+
+using namespace std;
+
+// 单生产者单消费者的有界环形队列，不加锁。
+// 生产者 claim() 取得空槽位、填好后 publish()；消费者 front() 原地使用槽位、用完后 pop() 归还
+template <class T>
+class SpscRing {
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head;    // 下一个待取的位置，只由消费者推进
+    alignas(64) atomic<size_t> tail;    // 下一个待写的位置，只由生产者推进
+
+public:
+    // capacity 须为 2 的幂
+    explicit SpscRing(size_t capacity) : slots(capacity), mask(capacity - 1), head(0), tail(0) {}
+
+    T* claim() {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == slots.size()) return nullptr;
+        return &slots[t & mask];
+    }
+
+    void publish() {
+        tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    T* front() {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return nullptr;
+        return &slots[h & mask];
+    }
+
+    void pop() {
+        head.store(head.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+};
+
+// 批量命令流的前端：读线程按大块读取输入、切分成行并提前解析，执行线程按原顺序逐条取用。
+// 行的切分与 getline 一致：以 '\n' 结尾，末尾没有换行的非空行也算一行
+class CommandPipeline {
+private:
+    static const size_t QUEUE_SLOTS = 1024;
+    static const size_t CHUNK_SIZE = 1 << 16;
+
+    int fd;
+    SpscRing<ParsedCommand> ring;
+    atomic<bool> finished;      // 读线程已读到输入末尾，队列中的命令是最后一批
+    atomic<bool> stopping;      // 执行线程不再需要后续命令
+    thread reader;
+
+    // 先自旋，再让出时间片，最后短暂休眠，避免输入很慢时空转
+    static void backoff(int& spins) {
+        spins++;
+        if (spins < 64) return;
+        if (spins < 128) {
+            this_thread::yield();
+            return;
+        }
+        this_thread::sleep_for(chrono::microseconds(50));
+    }
+
+    // 等待输入可读；期间定期检查 stopping，保证析构时能 join
+    bool wait_readable() {
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        while (!stopping.load(memory_order_relaxed)) {
+            pfd.revents = 0;
+            int ready = poll(&pfd, 1, 100);
+            if (ready > 0) return true;
+            if (ready < 0 && errno != EINTR) return true;   // 交给 read() 报告错误
+        }
+        return false;
+    }
+
+    bool emit(string& line) {
+        ParsedCommand* slot;
+        int spins = 0;
+        while ((slot = ring.claim()) == nullptr) {
+            if (stopping.load(memory_order_relaxed)) return false;
+            backoff(spins);
+        }
+        // 交换而不复制，槽位里旧字符串的容量留给下一行复用
+        slot->line.swap(line);
+        line.clear();
+        parse_command(*slot);
+        ring.publish();
+        return true;
+    }
+
+    void run() {
+        vector<char> chunk(CHUNK_SIZE);
+        string pending;
+        while (wait_readable()) {
+            ssize_t n = ::read(fd, &chunk[0], chunk.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            const char* begin = &chunk[0];
+            const char* end = begin + n;
+            const char* newline;
+            while ((newline = static_cast<const char*>(memchr(begin, '\n', end - begin))) != nullptr) {
+                pending.append(begin, newline);
+                if (!emit(pending)) {
+                    finished.store(true, memory_order_release);
+                    return;
+                }
+                begin = newline + 1;
+            }
+            pending.append(begin, end);
+        }
+        if (!pending.empty() && !stopping.load(memory_order_relaxed)) {
+            emit(pending);
+        }
+        finished.store(true, memory_order_release);
+    }
+
+public:
+    explicit CommandPipeline(int input_fd)
+        : fd(input_fd), ring(QUEUE_SLOTS), finished(false), stopping(false) {
+        reader = thread(&CommandPipeline::run, this);
+    }
+
+    ~CommandPipeline() {
+        stopping.store(true, memory_order_relaxed);
+        reader.join();
+    }
+
+    // 已解析好、可以立即执行的命令，没有时返回 nullptr
+    ParsedCommand* ready() { return ring.front(); }
+
+    // 等待下一条命令，输入结束时返回 nullptr
+    ParsedCommand* wait() {
+        int spins = 0;
+        while (true) {
+            ParsedCommand* cmd = ring.front();
+            if (cmd != nullptr) return cmd;
+            if (finished.load(memory_order_acquire)) return ring.front();
+            backoff(spins);
+        }
+    }
+
+    // 当前命令执行完毕，归还槽位
+    void pop() { ring.pop(); }
+};
+
+#endif // COMMANDPIPELINE_H
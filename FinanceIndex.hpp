@@ -0,0 +1,142 @@
+#ifndef FINANCEINDEX_H
+#define FINANCEINDEX_H
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// 按交易序号累计的收支前缀和：第 i 项为前 i 笔交易的总收入与总支出（单位：分）
+struct FinanceEntry {
+    long long income;
+    long long expense;
+
+    FinanceEntry() : income(0), expense(0) {}
+};
+
+class FinanceIndex {
+private:
+    string filename;
+    fstream data_file;
+    long long entry_count;      // 含第 0 项
+    FinanceEntry last_entry;
+    // 批处理：第 durable_count 项起的前缀和暂存在 pending 中，提交时一起写入
+    bool batching;
+    long long durable_count;
+    vector<FinanceEntry> pending;
+    FinanceEntry saved_last;
+
+    void write_entry(long long idx, const FinanceEntry& entry) {
+        write_entries(idx, &entry, 1);
+    }
+
+    bool write_entries(long long idx, const FinanceEntry* entries, size_t count) {
+        data_file.clear();
+        data_file.seekp(idx * (long long)sizeof(FinanceEntry));
+        data_file.write(reinterpret_cast<const char*>(entries), sizeof(FinanceEntry) * count);
+        data_file.flush();
+        return data_file.good();
+    }
+
+public:
+    FinanceIndex(const string& fname)
+        : filename(fname), entry_count(0), batching(false), durable_count(0) {
+        ifstream test(filename);
+        bool data_exists = test.good();
+        test.close();
+        if (!data_exists) {
+            ofstream create(filename, ios::binary);
+        }
+        data_file.open(filename, ios::in | ios::out | ios::binary);
+        data_file.seekg(0, ios::end);
+        entry_count = (long long)data_file.tellg() / (long long)sizeof(FinanceEntry);
+        if (entry_count == 0) {
+            write_entry(0, FinanceEntry());
+            entry_count = 1;
+        }
+        last_entry = at(entry_count - 1);
+    }
+
+    ~FinanceIndex() {
+        if (data_file.is_open()) {
+            data_file.close();
+        }
+    }
+
+    // 已累计的交易笔数
+    long long size() const { return entry_count - 1; }
+
+    FinanceEntry at(long long idx) {
+        FinanceEntry entry;
+        if (idx < 0 || idx >= entry_count) return entry;
+        if (batching && idx >= durable_count) return pending[(size_t)(idx - durable_count)];
+        data_file.clear();
+        data_file.seekg(idx * (long long)sizeof(FinanceEntry));
+        data_file.read(reinterpret_cast<char*>(&entry), sizeof(FinanceEntry));
+        return entry;
+    }
+
+    FinanceEntry total() const { return last_entry; }
+
+    void append(long long income, long long expense) {
+        last_entry.income += income;
+        last_entry.expense += expense;
+        if (batching) {
+            pending.push_back(last_entry);
+        } else {
+            write_entry(entry_count, last_entry);
+        }
+        entry_count++;
+    }
+
+    // 依次追加多笔交易的收支，一次写入
+    void append(const vector<pair<long long, long long>>& deltas) {
+        if (deltas.empty()) return;
+        vector<FinanceEntry> entries(deltas.size());
+        for (size_t i = 0; i < deltas.size(); i++) {
+            last_entry.income += deltas[i].first;
+            last_entry.expense += deltas[i].second;
+            entries[i] = last_entry;
+        }
+        if (batching) {
+            pending.insert(pending.end(), entries.begin(), entries.end());
+        } else {
+            write_entries(entry_count, &entries[0], entries.size());
+        }
+        entry_count += (long long)entries.size();
+    }
+
+    void begin_batch() {
+        if (batching) return;
+        durable_count = entry_count;
+        saved_last = last_entry;
+        batching = true;
+    }
+
+    bool commit_batch() {
+        if (!batching) return true;
+        batching = false;
+        bool success = pending.empty() || write_entries(durable_count, &pending[0], pending.size());
+        pending.clear();
+        return success;
+    }
+
+    void abort_batch() {
+        if (!batching) return;
+        batching = false;
+        entry_count = durable_count;
+        last_entry = saved_last;
+        pending.clear();
+    }
+
+    // 序号 [from, to) 内交易的收支合计
+    pair<long long, long long> range(long long from, long long to) {
+        FinanceEntry begin = at(from);
+        FinanceEntry end = at(to);
+        return make_pair(end.income - begin.income, end.expense - begin.expense);
+    }
+};
+
+#endif // FINANCEINDEX_H
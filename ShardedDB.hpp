@@ -0,0 +1,280 @@
+#ifndef SHARDEDDB_H
+#define SHARDEDDB_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <cstdio>
+#include "BlockListDB.hpp"
+#include "ThreadPool.hpp"
+
+using namespace std;
+
+// 按键的哈希分成若干个 BlockListDB 分片的逻辑数据库，接口与 BlockListDB 相同。
+// 点查询、写入只访问键所在的分片，只锁该分片；扫描并行读取各分片，再按键归并，结果与单个库的顺序一致。
+// 分片数记录在 <名称>.shards 中：打开时请求的分片数与记录不同则重新分布所有记录，请求 0 表示沿用已有布局。
+// 只有一个分片时就是原来的单个文件
+class ShardedDB {
+private:
+    string filename;
+    vector<unique_ptr<BlockListDB>> shards;
+    vector<unique_ptr<recursive_mutex>> locks;  // 每个分片一把，BlockListDB 的读写共用一个文件流，不能并发
+
+    static const size_t FIRST_CHUNK = 64;
+    static const size_t MAX_CHUNK = 1024;
+    static const size_t RESHARD_CHUNK = 4096;
+
+    // FNV-1a，分布持久化在文件里，不能用实现相关的 std::hash
+    static unsigned long long hash(const string& key) {
+        unsigned long long h = 1469598103934665603ULL;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    static string shard_file(const string& name, size_t index, size_t count) {
+        if (count == 1) return name;
+        string base = name;
+        string ext;
+        size_t dot = name.rfind('.');
+        if (dot != string::npos) {
+            base = name.substr(0, dot);
+            ext = name.substr(dot);
+        }
+        return base + "-" + to_string(index) + "-of-" + to_string(count) + ext;
+    }
+
+    size_t layout_count() {
+        ifstream layout(filename + ".shards");
+        size_t count = 0;
+        if (layout >> count && count > 0) return count;
+        return 1;
+    }
+
+    void save_layout(size_t count) {
+        ofstream layout(filename + ".shards", ios::trunc);
+        layout << count << '\n';
+    }
+
+    void open(size_t count) {
+        shards.clear();
+        locks.clear();
+        for (size_t i = 0; i < count; i++) {
+            shards.push_back(unique_ptr<BlockListDB>(new BlockListDB(shard_file(filename, i, count))));
+            locks.push_back(unique_ptr<recursive_mutex>(new recursive_mutex()));
+        }
+    }
+
+    // 把 old_count 个分片中的记录重新分布到 new_count 个分片。逐个旧分片按键顺序每次读出 RESHARD_CHUNK 条，
+    // 写入新分片后即提交，内存中只有一段记录与它改动的块。
+    // 先写好新文件再改布局记录，中途中断或写入失败时旧布局仍然完整，下次打开重做
+    void reshard(size_t old_count, size_t new_count) {
+        for (size_t i = 0; i < new_count; i++) std::remove(shard_file(filename, i, new_count).c_str());
+        open(new_count);
+        bool success = true;
+        for (size_t i = 0; i < old_count && success; i++) {
+            BlockListDB old(shard_file(filename, i, old_count));
+            string next;
+            bool done = false;
+            while (!done && success) {
+                vector<pair<string, string>> chunk;
+                old.scan_from(next, "", [&](const Record& record) {
+                    chunk.push_back(make_pair(record.get_index(), record.get_value()));
+                    return chunk.size() < RESHARD_CHUNK;
+                });
+                done = chunk.size() < RESHARD_CHUNK;
+                if (chunk.empty()) break;
+                // 紧接在最后一个键之后继续；键中不含 '\x01'
+                next = chunk.back().first + "\x01";
+                for (auto& shard : shards) shard->begin_batch();
+                for (const auto& record : chunk) {
+                    shards[hash(record.first) % new_count]->insert(record.first, record.second);
+                }
+                for (auto& shard : shards) success = shard->commit_batch() && success;
+            }
+        }
+        if (!success) {
+            open(old_count);
+            return;
+        }
+        save_layout(new_count);
+        for (size_t i = 0; i < old_count; i++) std::remove(shard_file(filename, i, old_count).c_str());
+    }
+
+    BlockListDB& shard_for(const string& key) {
+        return *shards[hash(key) % shards.size()];
+    }
+
+    recursive_mutex& lock_for(const string& key) {
+        return *locks[hash(key) % shards.size()];
+    }
+
+    // 一个分片上的扫描游标：按块读取从 next 起、以 prefix 开头的记录，每次读取的条数逐次加倍
+    struct Cursor {
+        string next;
+        vector<Record> buffer;
+        size_t pos;
+        size_t chunk;
+        bool done;
+        Cursor() : pos(0), chunk(FIRST_CHUNK), done(false) {}
+        size_t remaining() const { return buffer.size() - pos; }
+    };
+
+    void fill(size_t index, Cursor& cursor, const string& prefix) {
+        buffer_shift(cursor);
+        size_t wanted = cursor.chunk;
+        size_t got = 0;
+        {
+            lock_guard<recursive_mutex> lock(*locks[index]);
+            shards[index]->scan_from(cursor.next, prefix, [&](const Record& record) {
+                cursor.buffer.push_back(record);
+                return ++got < wanted;
+            });
+        }
+        if (got < wanted) {
+            cursor.done = true;
+        } else {
+            // 紧接在最后一个键之后继续；键中不含 '\x01'
+            cursor.next = string(cursor.buffer.back().index) + "\x01";
+        }
+        if (cursor.chunk < MAX_CHUNK) cursor.chunk *= 2;
+    }
+
+    static void buffer_shift(Cursor& cursor) {
+        cursor.buffer.erase(cursor.buffer.begin(), cursor.buffer.begin() + cursor.pos);
+        cursor.pos = 0;
+    }
+
+public:
+    // count 为请求的分片数，0 表示沿用已有布局（新库为 1 个分片）
+    ShardedDB(const string& name, size_t count = 0) : filename(name) {
+        size_t existing = layout_count();
+        if (count == 0 || count == existing) {
+            open(existing);
+        } else {
+            reshard(existing, count);
+        }
+    }
+
+    size_t shard_count() const { return shards.size(); }
+
+    // 按分片序号依次锁住全部分片，用于批处理的开始与结束
+    vector<unique_lock<recursive_mutex>> lock_all() {
+        vector<unique_lock<recursive_mutex>> held;
+        for (auto& lock : locks) held.push_back(unique_lock<recursive_mutex>(*lock));
+        return held;
+    }
+
+    bool insert(const string& key, const string& value) {
+        lock_guard<recursive_mutex> lock(lock_for(key));
+        return shard_for(key).insert(key, value);
+    }
+
+    bool insert_or_update(const string& key, const string& value) {
+        lock_guard<recursive_mutex> lock(lock_for(key));
+        return shard_for(key).insert_or_update(key, value);
+    }
+
+    bool remove(const string& key) {
+        lock_guard<recursive_mutex> lock(lock_for(key));
+        return shard_for(key).remove(key);
+    }
+
+    string find(const string& key) {
+        lock_guard<recursive_mutex> lock(lock_for(key));
+        return shard_for(key).find(key);
+    }
+
+    vector<pair<string, string>> find_all() {
+        vector<pair<string, string>> result;
+        scan_from("", "", [&](const Record& record) {
+            result.push_back(make_pair(record.get_index(), record.get_value()));
+            return true;
+        });
+        return result;
+    }
+
+    template <class Visitor>
+    void scan_prefix(const string& prefix, Visitor visit) {
+        scan_from(prefix, prefix, visit);
+    }
+
+    // 同 BlockListDB::scan_from。多个分片时各分片在共用的线程池上并行读取一块，归并时哪个分片的余量不足半块，
+    // 就在下一轮与其它同样不足的分片一起并行补读；visit 返回 false 时不再读取
+    template <class Visitor>
+    void scan_from(const string& start, const string& prefix, Visitor visit) {
+        if (shards.size() == 1) {
+            lock_guard<recursive_mutex> lock(*locks[0]);
+            shards[0]->scan_from(start, prefix, visit);
+            return;
+        }
+        vector<Cursor> cursors(shards.size());
+        for (auto& cursor : cursors) cursor.next = start;
+        while (true) {
+            vector<size_t> refill;
+            for (size_t i = 0; i < cursors.size(); i++) {
+                if (!cursors[i].done && cursors[i].remaining() < cursors[i].chunk / 2) refill.push_back(i);
+            }
+            run_parallel(refill.size(), [&](size_t k) {
+                fill(refill[k], cursors[refill[k]], prefix);
+            });
+            // 各分片的键互不相同，取当前最小者；某个未读完的分片读空时先补读
+            while (true) {
+                size_t best = cursors.size();
+                bool starved = false;
+                for (size_t i = 0; i < cursors.size(); i++) {
+                    if (cursors[i].remaining() == 0) {
+                        if (!cursors[i].done) starved = true;
+                        continue;
+                    }
+                    if (best == cursors.size()
+                        || strcmp(cursors[i].buffer[cursors[i].pos].index,
+                                  cursors[best].buffer[cursors[best].pos].index) < 0) {
+                        best = i;
+                    }
+                }
+                if (starved) break;
+                if (best == cursors.size()) return;
+                if (!visit(cursors[best].buffer[cursors[best].pos])) return;
+                cursors[best].pos++;
+            }
+        }
+    }
+
+    void begin_batch() {
+        for (size_t i = 0; i < shards.size(); i++) {
+            lock_guard<recursive_mutex> lock(*locks[i]);
+            shards[i]->begin_batch();
+        }
+    }
+
+    void journal_batch(BatchJournal& journal) {
+        for (size_t i = 0; i < shards.size(); i++) {
+            lock_guard<recursive_mutex> lock(*locks[i]);
+            shards[i]->journal_batch(journal);
+        }
+    }
+
+    // 每个分片都提交，返回是否全部成功
+    bool commit_batch() {
+        bool success = true;
+        for (size_t i = 0; i < shards.size(); i++) {
+            lock_guard<recursive_mutex> lock(*locks[i]);
+            success = shards[i]->commit_batch() && success;
+        }
+        return success;
+    }
+
+    void abort_batch() {
+        for (size_t i = 0; i < shards.size(); i++) {
+            lock_guard<recursive_mutex> lock(*locks[i]);
+            shards[i]->abort_batch();
+        }
+    }
+};
+
+#endif // SHARDEDDB_H
@@ -0,0 +1,111 @@
+#ifndef SHOWCACHE_H
+#define SHOWCACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+using namespace std;
+
+// show 结果缓存：保存渲染好的输出文本，按最近使用淘汰。
+// 每项带若干标签，写入图书时按受影响的标签精确失效。
+// 查询未命中时记下代数，渲染期间若有失效发生，渲染结果可能已过期，不再放入缓存
+class ShowCache {
+private:
+    struct Entry {
+        string key;
+        string text;
+        vector<string> tags;
+    };
+
+    list<Entry> lru;    // 表头为最近使用
+    unordered_map<string, list<Entry>::iterator> entries;
+    unordered_map<string, vector<string>> tagged;   // 标签 -> 带该标签的键
+    size_t max_entries;
+    size_t max_bytes;
+    size_t bytes;
+    unsigned long long generation;
+    mutex cache_mutex;
+
+    void erase(list<Entry>::iterator it) {
+        for (const auto& tag : it->tags) {
+            auto tag_it = tagged.find(tag);
+            if (tag_it == tagged.end()) continue;
+            vector<string>& keys = tag_it->second;
+            for (size_t i = 0; i < keys.size(); i++) {
+                if (keys[i] == it->key) {
+                    keys[i] = keys.back();
+                    keys.pop_back();
+                    break;
+                }
+            }
+            if (keys.empty()) tagged.erase(tag_it);
+        }
+        bytes -= it->text.size();
+        entries.erase(it->key);
+        lru.erase(it);
+    }
+
+public:
+    ShowCache(size_t entry_limit = 256, size_t byte_limit = 8 << 20)
+        : max_entries(entry_limit), max_bytes(byte_limit), bytes(0), generation(0) {}
+
+    // 命中时取出文本并返回 true；未命中时 gen 记下当前代数，供 put() 使用
+    bool get(const string& key, string& text, unsigned long long& gen) {
+        lock_guard<mutex> lock(cache_mutex);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            gen = generation;
+            return false;
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        text = it->second->text;
+        return true;
+    }
+
+    void put(const string& key, const string& text, const vector<string>& tags, unsigned long long gen) {
+        lock_guard<mutex> lock(cache_mutex);
+        if (gen != generation || text.size() > max_bytes) return;
+        auto it = entries.find(key);
+        if (it != entries.end()) erase(it->second);
+        Entry entry;
+        entry.key = key;
+        entry.text = text;
+        entry.tags = tags;
+        lru.push_front(entry);
+        entries[key] = lru.begin();
+        for (const auto& tag : tags) tagged[tag].push_back(key);
+        bytes += text.size();
+        while (entries.size() > max_entries || bytes > max_bytes) {
+            erase(prev(lru.end()));
+        }
+    }
+
+    // 使带有任一给定标签的项失效
+    void invalidate(const vector<string>& tags) {
+        lock_guard<mutex> lock(cache_mutex);
+        generation++;
+        for (const auto& tag : tags) {
+            auto tag_it = tagged.find(tag);
+            if (tag_it == tagged.end()) continue;
+            vector<string> keys = tag_it->second;
+            for (const auto& key : keys) {
+                auto it = entries.find(key);
+                if (it != entries.end()) erase(it->second);
+            }
+        }
+    }
+
+    void clear() {
+        lock_guard<mutex> lock(cache_mutex);
+        generation++;
+        lru.clear();
+        entries.clear();
+        tagged.clear();
+        bytes = 0;
+    }
+};
+
+#endif // SHOWCACHE_H
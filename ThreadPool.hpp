@@ -0,0 +1,131 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// 固定数量的工作线程，按提交顺序取任务执行；析构时先执行完已提交的任务再退出
+class ThreadPool {
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex tasks_mutex;
+    condition_variable tasks_ready;
+    bool stopping;
+
+    void work() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(tasks_mutex);
+                tasks_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t count) : stopping(false) {
+        if (count == 0) count = 1;
+        for (size_t i = 0; i < count; i++) {
+            workers.push_back(thread(&ThreadPool::work, this));
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(tasks_mutex);
+            stopping = true;
+        }
+        tasks_ready.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    size_t size() const { return workers.size(); }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(tasks_mutex);
+            tasks.push(move(task));
+        }
+        tasks_ready.notify_one();
+    }
+};
+
+// 并行扫描使用的线程数：BOOKSTORE_SCAN_THREADS=N 指定，未设置时取核数
+inline size_t scan_parallelism() {
+    static const size_t count = []() {
+        const char* env = getenv("BOOKSTORE_SCAN_THREADS");
+        int threads = env == nullptr ? 0 : atoi(env);
+        if (threads > 0) return (size_t)threads;
+        unsigned cores = thread::hardware_concurrency();
+        return cores == 0 ? (size_t)1 : (size_t)cores;
+    }();
+    return count;
+}
+
+// 把 [begin, end) 均分为 parts 段时第 part 段的起点，part == parts 时为 end
+inline long long part_begin(long long begin, long long end, size_t part, size_t parts) {
+    return begin + (end - begin) * (long long)part / (long long)parts;
+}
+
+// 并行扫描共用的工作线程，scan_parallelism() - 1 个（调用线程自己也执行），第一次使用时创建
+inline ThreadPool& scan_pool() {
+    static ThreadPool pool(scan_parallelism() > 1 ? scan_parallelism() - 1 : 1);
+    return pool;
+}
+
+// run_parallel 的一组段：执行者（调用线程与线程池中的任务）依次领取尚未开始的段
+struct ParallelParts {
+    atomic<size_t> next;
+    size_t parts;
+    size_t finished;
+    mutex finished_mutex;
+    condition_variable all_finished;
+
+    explicit ParallelParts(size_t count) : next(0), parts(count), finished(0) {}
+
+    template <class Fn>
+    void work(Fn& fn) {
+        for (size_t part = next.fetch_add(1); part < parts; part = next.fetch_add(1)) {
+            fn(part);
+            lock_guard<mutex> lock(finished_mutex);
+            if (++finished == parts) all_finished.notify_all();
+        }
+    }
+};
+
+// 并行执行 fn(0) ... fn(parts - 1)，全部完成后返回。各段由 scan_pool() 的线程与调用线程一起领取，
+// 不为每段创建线程；线程池忙（如多个会话同时扫描、扫描中再嵌套扫描）时调用线程会自己执行剩下的段，不会互相等死
+template <class Fn>
+void run_parallel(size_t parts, Fn fn) {
+    if (parts <= 1) {
+        if (parts == 1) fn(0);
+        return;
+    }
+    shared_ptr<ParallelParts> state = make_shared<ParallelParts>(parts);
+    // 迟到的任务领不到段，不会再访问 fn
+    Fn* target = &fn;
+    size_t helpers = min(parts - 1, scan_pool().size());
+    for (size_t i = 0; i < helpers; i++) {
+        scan_pool().submit([state, target]() { state->work(*target); });
+    }
+    state->work(fn);
+    unique_lock<mutex> lock(state->finished_mutex);
+    state->all_finished.wait(lock, [&state] { return state->finished == state->parts; });
+}
+
+#endif // THREADPOOL_H
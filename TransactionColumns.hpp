@@ -0,0 +1,184 @@
+#ifndef TRANSACTIONCOLUMNS_H
+#define TRANSACTIONCOLUMNS_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+using namespace std;
+
+// 字典编码：把重复出现的字符串映射为连续的整数编码，持久化为每行一个值的文本文件
+class ColumnDictionary {
+private:
+    string filename;
+    ofstream out;
+    vector<string> values;
+    unordered_map<string, unsigned> codes;
+
+public:
+    explicit ColumnDictionary(const string& fname) : filename(fname) {
+        ifstream in(filename);
+        string line;
+        while (getline(in, line)) {
+            codes[line] = (unsigned)values.size();
+            values.push_back(line);
+        }
+        in.close();
+        out.open(filename, ios::out | ios::app);
+    }
+
+    // 查找编码，不存在时返回 -1
+    long long find(const string& value) const {
+        auto it = codes.find(value);
+        return it == codes.end() ? -1 : (long long)it->second;
+    }
+
+    unsigned encode(const string& value) {
+        auto it = codes.find(value);
+        if (it != codes.end()) return it->second;
+        unsigned code = (unsigned)values.size();
+        codes[value] = code;
+        values.push_back(value);
+        out << value << '\n';
+        out.flush();
+        return code;
+    }
+
+    const string& decode(unsigned code) const { return values[code]; }
+    size_t size() const { return values.size(); }
+};
+
+// 交易历史的列式副本：每个字段一个连续数组，第 i 行对应交易日志中序号为 i 的交易。
+// 聚合与分组只需遍历用到的几列，每行几个字节。
+class TransactionColumns {
+private:
+    string base_name;
+    vector<char> type_col;          // 'b' 销售, 'i' 进货
+    vector<int> quantity_col;
+    vector<long long> total_col;    // 单位：分
+    vector<long long> timestamp_col;
+    vector<unsigned> user_col;
+    vector<unsigned> isbn_col;
+    ColumnDictionary users;
+    ColumnDictionary isbns;
+    fstream type_file, quantity_file, total_file, timestamp_file, user_file, isbn_file;
+    bool batching;
+    size_t batch_from;      // 批处理开始时的行数，之后的行提交时才写入
+
+    template <class T>
+    static size_t load_column(fstream& file, const string& name, vector<T>& column) {
+        {
+            ifstream test(name);
+            if (!test.good()) {
+                ofstream create(name, ios::binary);
+            }
+        }
+        file.open(name, ios::in | ios::out | ios::binary);
+        file.seekg(0, ios::end);
+        size_t rows = (size_t)file.tellg() / sizeof(T);
+        column.resize(rows);
+        file.seekg(0);
+        if (rows > 0) {
+            file.read(reinterpret_cast<char*>(&column[0]), sizeof(T) * rows);
+        }
+        return rows;
+    }
+
+    // 把第 from 行起新追加的值一次写入文件
+    template <class T>
+    static bool append_values(fstream& file, const vector<T>& column, size_t from) {
+        file.clear();
+        file.seekp((long long)from * sizeof(T));
+        file.write(reinterpret_cast<const char*>(&column[from]), sizeof(T) * (column.size() - from));
+        file.flush();
+        return file.good();
+    }
+
+public:
+    explicit TransactionColumns(const string& base)
+        : base_name(base), users(base + ".users.dict"), isbns(base + ".isbns.dict"), batching(false), batch_from(0) {
+        size_t rows = load_column(type_file, base + ".type", type_col);
+        rows = min(rows, load_column(quantity_file, base + ".quantity", quantity_col));
+        rows = min(rows, load_column(total_file, base + ".total", total_col));
+        rows = min(rows, load_column(timestamp_file, base + ".timestamp", timestamp_col));
+        rows = min(rows, load_column(user_file, base + ".user", user_col));
+        rows = min(rows, load_column(isbn_file, base + ".isbn", isbn_col));
+        // 写入中断时各列长度可能不一致，只保留完整的行，其余由调用方从日志补齐
+        type_col.resize(rows);
+        quantity_col.resize(rows);
+        total_col.resize(rows);
+        timestamp_col.resize(rows);
+        user_col.resize(rows);
+        isbn_col.resize(rows);
+    }
+
+    size_t size() const { return type_col.size(); }
+
+    void append(char type, int quantity, long long total, long long timestamp,
+                const string& user_id, const string& isbn) {
+        size_t from = size();
+        push(type, quantity, total, timestamp, user_id, isbn);
+        flush_rows(from);
+    }
+
+    // 批量追加：逐行 push() 后调用 flush_rows(push 之前的 size())，每列只写一次文件
+    void push(char type, int quantity, long long total, long long timestamp,
+              const string& user_id, const string& isbn) {
+        type_col.push_back(type);
+        quantity_col.push_back(quantity);
+        total_col.push_back(total);
+        timestamp_col.push_back(timestamp);
+        user_col.push_back(users.encode(user_id));
+        isbn_col.push_back(isbns.encode(isbn));
+    }
+
+    // 返回是否全部写成功
+    bool flush_rows(size_t from) {
+        if (batching || from >= size()) return true;
+        bool success = append_values(type_file, type_col, from);
+        success = append_values(quantity_file, quantity_col, from) && success;
+        success = append_values(total_file, total_col, from) && success;
+        success = append_values(timestamp_file, timestamp_col, from) && success;
+        success = append_values(user_file, user_col, from) && success;
+        success = append_values(isbn_file, isbn_col, from) && success;
+        return success;
+    }
+
+    void begin_batch() {
+        if (batching) return;
+        batch_from = size();
+        batching = true;
+    }
+
+    bool commit_batch() {
+        if (!batching) return true;
+        batching = false;
+        return flush_rows(batch_from);
+    }
+
+    // 丢弃批处理中追加的行；字典中新增的值已写入字典文件，只是不再被引用
+    void abort_batch() {
+        if (!batching) return;
+        batching = false;
+        type_col.resize(batch_from);
+        quantity_col.resize(batch_from);
+        total_col.resize(batch_from);
+        timestamp_col.resize(batch_from);
+        user_col.resize(batch_from);
+        isbn_col.resize(batch_from);
+    }
+
+    const vector<char>& types() const { return type_col; }
+    const vector<int>& quantities() const { return quantity_col; }
+    const vector<long long>& totals() const { return total_col; }
+    const vector<long long>& timestamps() const { return timestamp_col; }
+    const vector<unsigned>& user_codes() const { return user_col; }
+    const vector<unsigned>& isbn_codes() const { return isbn_col; }
+
+    const ColumnDictionary& user_dictionary() const { return users; }
+    const ColumnDictionary& isbn_dictionary() const { return isbns; }
+};
+
+#endif // TRANSACTIONCOLUMNS_H
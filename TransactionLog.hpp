@@ -0,0 +1,399 @@
+#ifndef TRANSACTIONLOG_H
+#define TRANSACTIONLOG_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "ThreadPool.hpp"
+#include "BatchJournal.hpp"
+
+using namespace std;
+
+const int LOG_SEGMENT_RECORDS = 8192;   // 每个段文件容纳的记录数
+const int LOG_INDEX_STRIDE = 64;        // 稀疏索引每隔多少条记录一项
+const int LOG_PARALLEL_MIN_RECORDS = 4096;  // 并行扫描时每段至少的记录数
+const int LOG_ID_SIZE = 40;
+const int LOG_ISBN_SIZE = 21;
+const int LOG_USER_SIZE = 31;
+
+// 定长二进制交易记录，第 seq 条位于段 seq / LOG_SEGMENT_RECORDS 的固定偏移处
+struct LogRecord {
+    long long seq;
+    long long timestamp;
+    long long price;    // 单位：分
+    long long total;
+    int quantity;
+    char type;      // 'b' 销售, 'i' 进货
+    char trans_id[LOG_ID_SIZE];
+    char isbn[LOG_ISBN_SIZE];
+    char user_id[LOG_USER_SIZE];
+
+    LogRecord() : seq(-1), timestamp(0), price(0), total(0), quantity(0), type(0) {
+        memset(trans_id, 0, sizeof(trans_id));
+        memset(isbn, 0, sizeof(isbn));
+        memset(user_id, 0, sizeof(user_id));
+    }
+};
+
+// 稀疏索引项：覆盖 [first_seq, first_seq + LOG_INDEX_STRIDE) 的记录及其时间戳范围
+struct LogIndexEntry {
+    long long first_seq;
+    long long min_timestamp;
+    long long max_timestamp;
+
+    LogIndexEntry() : first_seq(-1), min_timestamp(0), max_timestamp(0) {}
+};
+
+class TransactionLog {
+private:
+    string base_name;
+    fstream tail_file;          // 当前追加的段
+    int tail_segment;
+    fstream read_file;          // 随机读取用，缓存最近打开的段
+    int read_segment;
+    fstream index_file;
+    long long record_count;
+    vector<LogIndexEntry> sparse_index;
+    // prefix_max[k]：前 k+1 项的最大时间戳；suffix_min[k]：第 k 项及之后的最小时间戳。
+    // 二者都单调不减，时钟回拨时也能二分出时间窗所在的序号区间
+    vector<long long> prefix_max;
+    vector<long long> suffix_min;
+
+    // 批处理：期间追加的记录暂存在 pending 中（序号从 durable_count 起），提交时一起写入
+    bool batching;
+    long long durable_count;
+    vector<LogRecord> pending;
+    vector<LogIndexEntry> saved_index;
+    vector<long long> saved_prefix_max;
+    vector<long long> saved_suffix_min;
+
+    string segment_name(int segment) const {
+        return base_name + "." + to_string(segment) + ".log";
+    }
+
+    static bool file_exists(const string& name) {
+        ifstream test(name);
+        return test.good();
+    }
+
+    static long long file_size(const string& name) {
+        ifstream in(name, ios::binary | ios::ate);
+        if (!in.good()) return 0;
+        return (long long)in.tellg();
+    }
+
+    void open_tail(int segment) {
+        if (tail_file.is_open()) tail_file.close();
+        string name = segment_name(segment);
+        if (!file_exists(name)) {
+            ofstream create(name, ios::binary);
+        }
+        tail_file.open(name, ios::in | ios::out | ios::binary);
+        tail_segment = segment;
+    }
+
+    fstream& segment_for_read(int segment) {
+        if (segment == tail_segment) {
+            tail_file.flush();
+        }
+        if (read_segment != segment || !read_file.is_open()) {
+            if (read_file.is_open()) read_file.close();
+            read_file.open(segment_name(segment), ios::in | ios::binary);
+            read_segment = segment;
+        }
+        read_file.clear();
+        return read_file;
+    }
+
+    bool write_index_entry(size_t idx) {
+        if (batching) return true;  // 提交时写入
+        index_file.clear();
+        index_file.seekp((long long)idx * sizeof(LogIndexEntry));
+        index_file.write(reinterpret_cast<const char*>(&sparse_index[idx]), sizeof(LogIndexEntry));
+        index_file.flush();
+        return index_file.good();
+    }
+
+    void note_in_index(long long seq, long long timestamp) {
+        size_t idx = (size_t)(seq / LOG_INDEX_STRIDE);
+        if (idx == sparse_index.size()) {
+            LogIndexEntry entry;
+            entry.first_seq = seq;
+            entry.min_timestamp = timestamp;
+            entry.max_timestamp = timestamp;
+            sparse_index.push_back(entry);
+            prefix_max.push_back(idx > 0 ? max(prefix_max[idx - 1], timestamp) : timestamp);
+            suffix_min.push_back(timestamp);
+        } else {
+            LogIndexEntry& entry = sparse_index[idx];
+            entry.min_timestamp = min(entry.min_timestamp, timestamp);
+            entry.max_timestamp = max(entry.max_timestamp, timestamp);
+            prefix_max[idx] = max(prefix_max[idx], timestamp);
+            suffix_min[idx] = min(suffix_min[idx], timestamp);
+        }
+        // 时间戳通常递增，循环一般立即结束
+        for (size_t k = idx; k > 0 && suffix_min[k - 1] > suffix_min[k]; k--) {
+            suffix_min[k - 1] = suffix_min[k];
+        }
+        write_index_entry(idx);
+    }
+
+    void rebuild_bounds() {
+        size_t n = sparse_index.size();
+        prefix_max.assign(n, 0);
+        suffix_min.assign(n, 0);
+        for (size_t k = 0; k < n; k++) {
+            prefix_max[k] = k > 0 ? max(prefix_max[k - 1], sparse_index[k].max_timestamp) : sparse_index[k].max_timestamp;
+        }
+        for (size_t k = n; k > 0; k--) {
+            suffix_min[k - 1] = k < n ? min(suffix_min[k], sparse_index[k - 1].min_timestamp) : sparse_index[k - 1].min_timestamp;
+        }
+    }
+
+    void load_segments() {
+        int segments = 0;
+        while (file_exists(segment_name(segments))) segments++;
+        if (segments == 0) {
+            record_count = 0;
+            open_tail(0);
+            return;
+        }
+        int last = segments - 1;
+        long long tail_records = file_size(segment_name(last)) / (long long)sizeof(LogRecord);
+        record_count = (long long)last * LOG_SEGMENT_RECORDS + tail_records;
+        open_tail(last);
+    }
+
+    void load_index() {
+        string name = base_name + ".idx";
+        if (!file_exists(name)) {
+            ofstream create(name, ios::binary);
+        }
+        index_file.open(name, ios::in | ios::out | ios::binary);
+
+        long long entries = file_size(name) / (long long)sizeof(LogIndexEntry);
+        long long expected = (record_count + LOG_INDEX_STRIDE - 1) / LOG_INDEX_STRIDE;
+        sparse_index.assign((size_t)min(entries, expected), LogIndexEntry());
+        index_file.clear();
+        index_file.seekg(0);
+        if (!sparse_index.empty()) {
+            index_file.read(reinterpret_cast<char*>(&sparse_index[0]), sizeof(LogIndexEntry) * sparse_index.size());
+        }
+        // 索引最后一项可能尚未覆盖到崩溃前写入的记录，从日志补齐
+        long long from = sparse_index.empty() ? 0 : (long long)(sparse_index.size() - 1) * LOG_INDEX_STRIDE;
+        if (!sparse_index.empty()) sparse_index.pop_back();
+        rebuild_bounds();
+        scan(from, record_count, [&](const LogRecord& record) {
+            note_in_index(record.seq, record.timestamp);
+            return true;
+        });
+    }
+
+    // 把从 first 起的 count 条记录写入各段，同一段内一次写入
+    bool write_records(long long first, const LogRecord* records, size_t count) {
+        size_t done = 0;
+        while (done < count) {
+            long long seq = first + (long long)done;
+            int segment = (int)(seq / LOG_SEGMENT_RECORDS);
+            size_t batch = (size_t)min((long long)(count - done), (long long)(segment + 1) * LOG_SEGMENT_RECORDS - seq);
+            if (segment != tail_segment) open_tail(segment);
+            tail_file.clear();
+            tail_file.seekp((seq % LOG_SEGMENT_RECORDS) * (long long)sizeof(LogRecord));
+            tail_file.write(reinterpret_cast<const char*>(records + done), sizeof(LogRecord) * batch);
+            done += batch;
+        }
+        tail_file.flush();
+        return tail_file.good();
+    }
+
+public:
+    TransactionLog(const string& base)
+        : base_name(base), tail_segment(-1), read_segment(-1), record_count(0), batching(false), durable_count(0) {
+        load_segments();
+        load_index();
+    }
+
+    ~TransactionLog() {
+        if (tail_file.is_open()) tail_file.close();
+        if (read_file.is_open()) read_file.close();
+        if (index_file.is_open()) index_file.close();
+    }
+
+    long long size() const { return record_count; }
+
+    const vector<LogIndexEntry>& index() const { return sparse_index; }
+
+    // 顺序追加一条记录并返回其序号
+    long long append(LogRecord& record) {
+        return append(&record, 1);
+    }
+
+    // 顺序追加 count 条记录，只刷新一次；返回第一条的序号，失败时返回 -1
+    long long append(LogRecord* records, size_t count) {
+        long long first = record_count;
+        for (size_t i = 0; i < count; i++) records[i].seq = first + (long long)i;
+        if (batching) {
+            pending.insert(pending.end(), records, records + count);
+        } else if (!write_records(first, records, count)) {
+            return -1;
+        }
+        record_count += (long long)count;
+        for (size_t i = 0; i < count; i++) note_in_index(records[i].seq, records[i].timestamp);
+        return first;
+    }
+
+    void begin_batch() {
+        if (batching) return;
+        durable_count = record_count;
+        saved_index = sparse_index;
+        saved_prefix_max = prefix_max;
+        saved_suffix_min = suffix_min;
+        batching = true;
+    }
+
+    // 把 commit_batch() 将要写入的记录与稀疏索引项记进 journal，不改动文件
+    void journal_batch(BatchJournal& journal) const {
+        if (!batching) return;
+        for (size_t done = 0; done < pending.size(); ) {
+            long long seq = durable_count + (long long)done;
+            int segment = (int)(seq / LOG_SEGMENT_RECORDS);
+            size_t count = (size_t)min((long long)(pending.size() - done), (long long)(segment + 1) * LOG_SEGMENT_RECORDS - seq);
+            journal.add(segment_name(segment), (seq % LOG_SEGMENT_RECORDS) * (long long)sizeof(LogRecord),
+                        reinterpret_cast<const char*>(&pending[done]), sizeof(LogRecord) * count);
+            done += count;
+        }
+        for (size_t idx = (size_t)(durable_count / LOG_INDEX_STRIDE); idx < sparse_index.size(); idx++) {
+            journal.add(base_name + ".idx", (long long)idx * sizeof(LogIndexEntry),
+                        reinterpret_cast<const char*>(&sparse_index[idx]), sizeof(LogIndexEntry));
+        }
+    }
+
+    bool commit_batch() {
+        if (!batching) return true;
+        batching = false;
+        bool success = pending.empty() || write_records(durable_count, &pending[0], pending.size());
+        if (success) {
+            // 记录已写入，索引项写失败时不撤销，只报告失败
+            for (size_t idx = (size_t)(durable_count / LOG_INDEX_STRIDE); idx < sparse_index.size(); idx++) {
+                success = write_index_entry(idx) && success;
+            }
+        } else {
+            record_count = durable_count;
+            sparse_index.swap(saved_index);
+            prefix_max.swap(saved_prefix_max);
+            suffix_min.swap(saved_suffix_min);
+        }
+        pending.clear();
+        saved_index.clear();
+        saved_prefix_max.clear();
+        saved_suffix_min.clear();
+        return success;
+    }
+
+    void abort_batch() {
+        if (!batching) return;
+        batching = false;
+        record_count = durable_count;
+        pending.clear();
+        sparse_index.swap(saved_index);
+        prefix_max.swap(saved_prefix_max);
+        suffix_min.swap(saved_suffix_min);
+        saved_index.clear();
+        saved_prefix_max.clear();
+        saved_suffix_min.clear();
+    }
+
+    // 可能含有 [from_ts, to_ts] 内记录的序号区间 [first, second)，区间外的记录一定不在时间窗内
+    pair<long long, long long> time_window(long long from_ts, long long to_ts) const {
+        size_t lo = lower_bound(prefix_max.begin(), prefix_max.end(), from_ts) - prefix_max.begin();
+        size_t hi = upper_bound(suffix_min.begin(), suffix_min.end(), to_ts) - suffix_min.begin();
+        if (hi <= lo) return make_pair(0LL, 0LL);
+        return make_pair((long long)lo * LOG_INDEX_STRIDE, min((long long)hi * LOG_INDEX_STRIDE, record_count));
+    }
+
+    bool read(long long seq, LogRecord& record) {
+        if (seq < 0 || seq >= record_count) return false;
+        if (batching && seq >= durable_count) {
+            record = pending[(size_t)(seq - durable_count)];
+            return true;
+        }
+        fstream& in = segment_for_read((int)(seq / LOG_SEGMENT_RECORDS));
+        in.seekg((seq % LOG_SEGMENT_RECORDS) * (long long)sizeof(LogRecord));
+        in.read(reinterpret_cast<char*>(&record), sizeof(LogRecord));
+        return in.good();
+    }
+
+    // 按序号顺序访问 [from, to) 内的记录，每个段只做一次连续读取；visit 返回 false 时提前结束
+    template <class Visitor>
+    void scan(long long from, long long to, Visitor visit) {
+        from = max(from, 0LL);
+        to = min(to, record_count);
+        vector<LogRecord> buffer;
+        long long file_to = batching ? min(to, durable_count) : to;
+        while (from < file_to) {
+            int segment = (int)(from / LOG_SEGMENT_RECORDS);
+            long long segment_end = min(file_to, (long long)(segment + 1) * LOG_SEGMENT_RECORDS);
+            long long batch = min(segment_end - from, (long long)LOG_INDEX_STRIDE * 16);
+            buffer.resize((size_t)batch);
+            fstream& in = segment_for_read(segment);
+            in.seekg((from % LOG_SEGMENT_RECORDS) * (long long)sizeof(LogRecord));
+            in.read(reinterpret_cast<char*>(&buffer[0]), sizeof(LogRecord) * batch);
+            if (!in.good()) return;
+            for (const auto& record : buffer) {
+                if (!visit(record)) return;
+            }
+            from += batch;
+        }
+        for (; from < to; from++) {
+            if (!visit(pending[(size_t)(from - durable_count)])) return;
+        }
+    }
+
+    // 并行扫描 [from, to)：按序号均分成至多 parts 段，每段至少 LOG_PARALLEL_MIN_RECORDS 条，
+    // 各段在自己的线程中用独立的文件流按序号顺序调用 visit(段号, 记录)，visit 返回 false 时该段提前结束。
+    // 段号小的段序号也小，调用方按段号合并各段的部分结果即保持顺序。返回实际的段数。扫描期间不能有追加
+    template <class Visitor>
+    size_t parallel_scan(long long from, long long to, size_t parts, Visitor visit) {
+        from = max(from, 0LL);
+        to = min(to, record_count);
+        if (to <= from) return 0;
+        if (tail_file.is_open()) tail_file.flush();
+        parts = max<size_t>(1, min(parts, (size_t)((to - from) / LOG_PARALLEL_MIN_RECORDS)));
+        long long file_to = batching ? min(to, durable_count) : to;
+        run_parallel(parts, [&](size_t part) {
+            long long seq = part_begin(from, to, part, parts);
+            long long end = part_begin(from, to, part + 1, parts);
+            ifstream in;
+            int open_segment = -1;
+            vector<LogRecord> buffer;
+            while (seq < min(end, file_to)) {
+                int segment = (int)(seq / LOG_SEGMENT_RECORDS);
+                long long segment_end = min(min(end, file_to), (long long)(segment + 1) * LOG_SEGMENT_RECORDS);
+                long long batch = min(segment_end - seq, (long long)LOG_INDEX_STRIDE * 16);
+                if (segment != open_segment) {
+                    if (in.is_open()) in.close();
+                    in.open(segment_name(segment), ios::in | ios::binary);
+                    open_segment = segment;
+                }
+                buffer.resize((size_t)batch);
+                in.clear();
+                in.seekg((seq % LOG_SEGMENT_RECORDS) * (long long)sizeof(LogRecord));
+                in.read(reinterpret_cast<char*>(&buffer[0]), sizeof(LogRecord) * batch);
+                if (!in.good()) return;
+                for (const auto& record : buffer) {
+                    if (!visit(part, record)) return;
+                }
+                seq += batch;
+            }
+            for (; seq < end; seq++) {
+                if (!visit(part, pending[(size_t)(seq - durable_count)])) return;
+            }
+        });
+        return parts;
+    }
+};
+
+#endif // TRANSACTIONLOG_H
@@ -0,0 +1,312 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "BlockListDB.hpp"
+#include "storage.h"
+#include "command.h"
+#include "book.h"
+#include "user.h"
+#include "transaction.h"
+#include "money.h"
+#include "utils.h"
+
+// 微基准：bench [--sizes=10000,100000,1000000] [--filter=子串]
+// 结果以 JSON 写到标准输出，每项给出每秒操作数与单次操作延迟的分位数（纳秒）。
+// 所有数据文件都建在临时目录中，结束时删除
+
+// 全局 storage 构造时就会在当前目录打开数据文件，须在它之前切换到临时目录（同一文件内按定义顺序初始化）
+static std::string enter_scratch_directory(){
+    const char* tmp = std::getenv("TMPDIR");
+    std::string pattern = std::string(tmp != nullptr && *tmp != '\0' ? tmp : "/tmp") + "/bookstore-bench-XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    if (mkdtemp(&path[0]) == nullptr || chdir(&path[0]) != 0){
+        std::cerr << "Fail to create scratch directory" << std::endl;
+        std::exit(1);
+    }
+    return std::string(&path[0]);
+}
+static std::string scratch_dir = enter_scratch_directory();
+Storage storage;
+
+static int remove_entry(const char* path, const struct stat*, int, struct FTW*){
+    return std::remove(path);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static long long elapsed_ns(Clock::time_point begin, Clock::time_point end){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+}
+
+// 一项结果。samples 为每个样本的平均单次耗时，样本由 batch 次连续操作组成
+struct Result{
+    std::string name;
+    long long records;
+    long long ops;
+    long long total_ns;
+    std::vector<long long> samples;
+};
+
+static std::vector<Result> results;
+static std::string filter;
+
+static bool selected(const std::string& name){
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+static void add_result(const std::string& name, long long records, const std::vector<long long>& samples){
+    Result result;
+    result.name = name;
+    result.records = records;
+    result.ops = (long long)samples.size();
+    result.total_ns = 0;
+    for (long long ns : samples) result.total_ns += ns;
+    result.samples = samples;
+    results.push_back(result);
+}
+
+// 执行 ops 次 op(i)，每 batch 次计一个样本。很快的操作要成批计时，否则时钟本身的开销会盖过被测操作
+static void measure(const std::string& name, long long records, long long ops, long long batch,
+                    const std::function<void(long long)>& op){
+    if (!selected(name)) return;
+    Result result;
+    result.name = name;
+    result.records = records;
+    result.ops = 0;
+    result.total_ns = 0;
+    for (long long i = 0; i < ops; i += batch){
+        long long end = std::min(ops, i + batch);
+        Clock::time_point begin = Clock::now();
+        for (long long k = i; k < end; k++) op(k);
+        long long ns = elapsed_ns(begin, Clock::now());
+        result.total_ns += ns;
+        result.ops += end - i;
+        result.samples.push_back(ns / (end - i));
+    }
+    results.push_back(result);
+}
+
+static long long percentile(const std::vector<long long>& sorted, double p){
+    if (sorted.empty()) return 0;
+    size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static void print_json(){
+    std::cout << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++){
+        Result& r = results[i];
+        std::vector<long long> sorted = r.samples;
+        std::sort(sorted.begin(), sorted.end());
+        double seconds = r.total_ns / 1e9;
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "%s\n    {\"name\": \"%s\", \"records\": %lld, \"ops\": %lld, \"ops_per_sec\": %.1f, "
+                      "\"mean_ns\": %lld, \"p50_ns\": %lld, \"p90_ns\": %lld, \"p99_ns\": %lld, "
+                      "\"p999_ns\": %lld, \"max_ns\": %lld}",
+                      i == 0 ? "" : ",", r.name.c_str(), r.records, r.ops,
+                      seconds > 0 ? r.ops / seconds : 0.0,
+                      r.ops > 0 ? r.total_ns / r.ops : 0,
+                      percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99),
+                      percentile(sorted, 0.999), sorted.empty() ? 0 : sorted.back());
+        std::cout << line;
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+}
+
+static long long file_size(const std::string& name){
+    struct stat info;
+    return stat(name.c_str(), &info) == 0 ? (long long)info.st_size : 0;
+}
+
+static std::string bench_key(long long i){
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "bench:%08lld", i);
+    return buf;
+}
+
+// BlockListDB：n 条记录下的插入、查找、前缀扫描、删除。
+// 块满时分裂会在文件末尾追加新块，插入后文件变大的那些插入另外汇总为 split
+static void bench_blocklist(long long n, std::mt19937_64& rng){
+    std::string prefix = "blocklist." + std::to_string(n) + ".";
+    std::vector<long long> order(n);
+    for (long long i = 0; i < n; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    long long probes = std::min(n, 100000LL);
+    std::string file = "bench_" + std::to_string(n) + ".db";
+    std::string value(64, 'v');
+    {
+        BlockListDB db(file);
+        std::vector<long long> inserts, splits;
+        long long size = file_size(file);
+        for (long long i = 0; i < n; i++){
+            Clock::time_point begin = Clock::now();
+            db.insert(bench_key(order[i]), value);
+            long long ns = elapsed_ns(begin, Clock::now());
+            inserts.push_back(ns);
+            long long grown = file_size(file);
+            if (grown > size){
+                splits.push_back(ns);
+                size = grown;
+            }
+        }
+        if (selected(prefix + "insert")) add_result(prefix + "insert", n, inserts);
+        if (selected(prefix + "split")) add_result(prefix + "split", n, splits);
+
+        std::uniform_int_distribution<long long> pick(0, n - 1);
+        measure(prefix + "find", n, probes, 1, [&](long long){
+            db.find(bench_key(pick(rng)));
+        });
+        // 每次扫描取一个8位键的前5位为前缀，约1000条记录
+        measure(prefix + "scan_prefix", n, std::min(n / 10 + 1, 200LL), 1, [&](long long){
+            std::string start = bench_key(pick(rng)).substr(0, 11);
+            long long visited = 0;
+            db.scan_prefix(start, [&](const Record&){
+                visited++;
+                return true;
+            });
+        });
+        // 全表并行扫描，各段计数后合并；线程数见 BOOKSTORE_SCAN_THREADS
+        measure(prefix + "parallel_scan", n, 5, 1, [&](long long){
+            std::vector<long long> counts(scan_parallelism());
+            size_t parts = db.parallel_scan("", counts.size(), [&](size_t part, const Record&){
+                counts[part]++;
+                return true;
+            });
+            long long total = 0;
+            for (size_t part = 0; part < parts; part++) total += counts[part];
+            if (total != n) std::cerr << "parallel_scan visited " << total << " of " << n << std::endl;
+        });
+        measure(prefix + "remove", n, probes, 1, [&](long long i){
+            db.remove(bench_key(order[i]));
+        });
+    }
+    std::remove(file.c_str());
+}
+
+// Storage 的存取路径：序列化后写入、读出后反序列化，含二级索引与交易日志的维护
+static void bench_storage(long long n, std::mt19937_64& rng){
+    std::string prefix = "storage." + std::to_string(n) + ".";
+    std::uniform_int_distribution<long long> pick(0, n - 1);
+    auto make_book = [](long long i){
+        Book book;
+        book.isbn = "978-" + std::to_string(1000000 + i);
+        book.name = "Book " + std::to_string(i % 5000);
+        book.author = "Author " + std::to_string(i % 700);
+        book.keywords.push_back("kw" + std::to_string(i % 30));
+        book.keywords.push_back("kw" + std::to_string(i % 7 + 30));
+        book.price = Money(1999 + i % 100);
+        book.quantity = (int)(i % 50);
+        return book;
+    };
+    // 读取类的项依赖前面写入的数据，写入项被 --filter 排除时照样写入，只是不计时
+    auto save_book = [&](long long i){
+        storage.save_book(make_book(i));
+    };
+    if (selected(prefix + "save_book")) measure(prefix + "save_book", n, n, 1, save_book);
+    else for (long long i = 0; i < n; i++) save_book(i);
+    measure(prefix + "load_book", n, std::min(n, 100000LL), 1, [&](long long){
+        storage.load_book(make_book(pick(rng)).isbn);
+    });
+    auto save_user = [&](long long i){
+        User user;
+        user.id = "user" + std::to_string(i);
+        user.name = "Name" + std::to_string(i);
+        user.password = "pw" + std::to_string(i);
+        user.privilege = 3;
+        storage.save_user(user);
+    };
+    if (selected(prefix + "save_user")) measure(prefix + "save_user", n, std::min(n, 100000LL), 1, save_user);
+    else for (long long i = 0; i < std::min(n, 100000LL); i++) save_user(i);
+    measure(prefix + "load_user", n, std::min(n, 100000LL), 1, [&](long long){
+        storage.load_user("user" + std::to_string(pick(rng) % std::min(n, 100000LL)));
+    });
+    measure(prefix + "save_transaction", n, n, 1, [&](long long i){
+        Transaction trans;
+        trans.trans_id = generate_trans_id();
+        trans.type = i % 3 == 0 ? "import" : "buy";
+        trans.isbn = make_book(i).isbn;
+        trans.quantity = 1 + (int)(i % 5);
+        trans.price = Money(1999);
+        trans.total = Money(1999 * trans.quantity);
+        trans.user_id = "user" + std::to_string(i % 100);
+        trans.timestamp = 1700000000000000LL + i * 1000000;
+        storage.save_transaction(trans);
+    });
+    measure(prefix + "recent_transactions_100", n, 1000, 1, [&](long long){
+        storage.get_recent_transactions(100);
+    });
+}
+
+// 命令解析、金额与时间的格式化：单次只有几十到几百纳秒，每 100 次计一个样本
+static void bench_text(std::mt19937_64& rng){
+    const char* lines[] = {
+        "show -ISBN=978-7-111-54742-6",
+        "modify -name=\"The Art of Computer Programming\" -author=\"Donald Knuth\" -price=199.99",
+        "buy 978-7-111-54742-6 3",
+        "su user42 password42",
+        "show finance 10",
+        "checkout 978-1 2 978-2 1 978-3 5",
+    };
+    const size_t line_count = sizeof(lines) / sizeof(lines[0]);
+    ParsedCommand cmd;
+    measure("text.parse_command", 0, 1000000, 100, [&](long long i){
+        cmd.line = lines[i % line_count];
+        parse_command(cmd);
+    });
+    char buf[64];
+    std::uniform_int_distribution<long long> cents(0, 100000000);
+    std::vector<Money> amounts(1024);
+    for (auto& amount : amounts) amount = Money(cents(rng));
+    measure("text.format_money", 0, 1000000, 100, [&](long long i){
+        format_money(amounts[i & 1023], buf);
+    });
+    std::vector<std::string> texts;
+    for (const auto& amount : amounts) texts.push_back(format_money(amount));
+    measure("text.parse_money", 0, 1000000, 100, [&](long long i){
+        Money value;
+        parse_money(texts[i & 1023], value);
+    });
+    // 报表中的交易时间大多落在同一天内
+    measure("text.format_time", 0, 1000000, 100, [&](long long i){
+        format_time(1700000000000000LL + i * 20000, buf);
+    });
+}
+
+int main(int argc, char** argv){
+    std::vector<long long> sizes = {10000, 100000, 1000000};
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if (arg.compare(0, 8, "--sizes=") == 0){
+            sizes.clear();
+            for (const auto& part : split_string(arg.substr(8), ',')){
+                long long size = std::atoll(part.c_str());
+                if (size > 0) sizes.push_back(size);
+            }
+        } else if (arg.compare(0, 9, "--filter=") == 0){
+            filter = arg.substr(9);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--sizes=N,N,...] [--filter=NAME]" << std::endl;
+            return 1;
+        }
+    }
+    std::mt19937_64 rng(20240601);
+    if (!storage.initialize()) return 1;
+    for (long long n : sizes) bench_blocklist(n, rng);
+    bench_storage(std::min(sizes.empty() ? 10000LL : *std::min_element(sizes.begin(), sizes.end()), 100000LL), rng);
+    bench_text(rng);
+    print_json();
+    nftw(scratch_dir.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
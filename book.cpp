@@ -6,53 +6,63 @@
 #include <iostream>
 #include <algorithm>
 #include <chrono>
+#include <map>
+#include <climits>
 
 std::vector<Book> show_books(Storage& storage, const std::string& condition_type, const std::string& condition_value){
-    std::vector<Book> all = storage.get_all_books();
     std::vector<Book> result;
     if (condition_type.empty()) {
-        // 没有筛选条件，返回所有图书
-        std::sort(all.begin(), all.end(), [](const Book& a, const Book& b){
-            return a.isbn < b.isbn;
-        });
-        return all;
+        // 没有筛选条件，返回所有图书（存储层已按ISBN升序）
+        return storage.get_all_books();
     }
     if (condition_value.empty()) {
         return result;
     }
-    for (const auto& book : all){
-        bool match = false;
-        if (condition_type == "ISBN") {
-            match = (book.isbn == condition_value);
-        }
-        else if (condition_type == "name") {
-            match = (book.name == condition_value);
-        }
-        else if (condition_type == "author") {
-            match = (book.author == condition_value);
-        }
-        else if (condition_type == "keyword") {
-            for (const auto& kw : book.keywords){
-                if (kw == condition_value){
-                    match = true;
-                    break;
-                }
-            }
-        }
-        if (match) {
-            result.push_back(book);
-        }
+    if (condition_type == "ISBN") {
+        Book book = storage.load_book(condition_value);
+        if (book.valid()) result.push_back(book);
+    }
+    else if (condition_type == "name") {
+        result = storage.get_books_by_name(condition_value);
+    }
+    else if (condition_type == "author") {
+        result = storage.get_books_by_author(condition_value);
+    }
+    else if (condition_type == "keyword") {
+        result = storage.get_books_by_keyword(condition_value);
     }
-    // 按ISBN升序排序
-    std::sort(result.begin(), result.end(), [](const Book& a, const Book& b){
-        return a.isbn < b.isbn;
-    });
-
     return result;
 }
+std::vector<Book> show_books(Storage& storage, const std::vector<std::pair<std::string, std::string>>& conditions,
+                             const PageRange& page){
+    if (!page.unbounded()) {
+        return storage.find_books(conditions, page);
+    }
+    if (conditions.empty()) {
+        return show_books(storage);
+    }
+    // 单个精确条件直接按索引查；多个条件或子串、前缀条件求交
+    if (conditions.size() == 1 && conditions[0].first.find('-') == std::string::npos) {
+        return show_books(storage, conditions[0].first, conditions[0].second);
+    }
+    return storage.find_books(conditions);
+}
+// 锁住当前选中的图书（以及 other_isbn），isbn 返回锁住的选中项。
+// 等锁期间若这本书被其它会话改了 ISBN，选中项会随之改变，此时按新的 ISBN 重新加锁
+static Storage::KeyGuard lock_selected_book(Storage& storage, SystemState& state, std::string& isbn,
+                                            const std::string& other_isbn = ""){
+    while (true){
+        isbn = state.getSelectedIsbn();
+        std::vector<std::string> keys(1, "book:" + isbn);
+        if (!other_isbn.empty()) keys.push_back("book:" + other_isbn);
+        Storage::KeyGuard guard = storage.lock_keys(keys);
+        if (state.getSelectedIsbn() == isbn) return guard;
+    }
+}
 bool select_book(Storage& storage, SystemState& state, const std::string& isbn){
     if (state.getCurrentPrivilege() < 3) return false;
     if (!valid_isbn(isbn)) return false;
+    Storage::KeyGuard guard = storage.lock_key("book:" + isbn);
     Book book = storage.load_book(isbn);
     if (!book.valid()){
         Book new_book;
@@ -60,7 +70,7 @@ bool select_book(Storage& storage, SystemState& state, const std::string& isbn){
         new_book.name = "";
         new_book.author = "";
         new_book.keywords.clear();
-        new_book.price = 0.0;
+        new_book.price = Money();
         new_book.quantity = 0;
         if (!storage.save_book(new_book)) {
             return false;
@@ -70,7 +80,13 @@ bool select_book(Storage& storage, SystemState& state, const std::string& isbn){
     return true;
 }
 bool modify_book(Storage& storage, SystemState& state, const std::vector<std::pair<std::string, std::string>>& modifications){
-    std::string selected_isbn = state.getSelectedIsbn();
+    // 改 ISBN 时新旧两条记录一起锁住，检查新 ISBN 未被占用与写入之间不会被其它会话抢先
+    std::string target_isbn;
+    for (const auto& mod : modifications){
+        if (mod.first == "ISBN" && target_isbn.empty()) target_isbn = mod.second;
+    }
+    std::string selected_isbn;
+    Storage::KeyGuard guard = lock_selected_book(storage, state, selected_isbn, target_isbn);
     if (selected_isbn.empty()) return false;
     Book book = storage.load_book(selected_isbn);
     if (!book.valid()) return false;
@@ -132,14 +148,13 @@ bool modify_book(Storage& storage, SystemState& state, const std::vector<std::pa
             book.keywords = keywords;
         }
         else if (type == "price"){
-            if (!valid_price(value)) return false;
-            book.price = std::stod(value);
+            if (!parse_money(value, book.price)) return false;
         }
     }
     if (isbn_changed){
         if (!storage.save_book(book)) return false;
         storage.delete_book(old_isbn);
-        state.updateSelectedIsbnAll(old_isbn, new_isbn);
+        update_selected_isbn_all_sessions(old_isbn, new_isbn);
     }
     else {
         // ISBN未改变，直接保存
@@ -147,11 +162,12 @@ bool modify_book(Storage& storage, SystemState& state, const std::vector<std::pa
     }
     return true;
 }
-bool import_book(Storage& storage, SystemState& state, int quantity, double total_cost){
+bool import_book(Storage& storage, SystemState& state, int quantity, Money total_cost){
     if (state.getCurrentPrivilege() < 3) return false;
-    std::string selected_isbn = state.getSelectedIsbn();
+    std::string selected_isbn;
+    Storage::KeyGuard guard = lock_selected_book(storage, state, selected_isbn);
     if (selected_isbn.empty()) return false;
-    if (quantity <= 0 || total_cost <= 0) return false;
+    if (quantity <= 0 || total_cost.cents <= 0) return false;
     Book book = storage.load_book(selected_isbn);
     if (!book.valid()) return false;
     book.quantity += quantity;
@@ -161,7 +177,7 @@ bool import_book(Storage& storage, SystemState& state, int quantity, double tota
     trans.type = "import";
     trans.isbn = selected_isbn;
     trans.quantity = quantity;
-    trans.price = total_cost / quantity;
+    trans.price = divide_money(total_cost, quantity);
     trans.total = total_cost;
     trans.user_id = state.getCurrentUserId();
     trans.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
@@ -174,30 +190,68 @@ bool import_book(Storage& storage, SystemState& state, int quantity, double tota
     }
     return true;
 }
-double buy_book(Storage& storage, SystemState& state, const std::string& isbn, int quantity){
-    if (state.getCurrentPrivilege() < 1) return -1.0;
-    if (!valid_isbn(isbn) || quantity <= 0) return -1.0;
-    Book book = storage.load_book(isbn);
-    if (!book.valid()) return -1.0;
-    if (book.quantity < quantity) return -1.0;
-    double total = book.price * quantity;
-    book.quantity -= quantity;
-    if (!storage.save_book(book)) return -1.0;
-    Transaction trans;
-    trans.trans_id = generate_trans_id();
-    trans.type = "buy";
-    trans.isbn = isbn;
-    trans.quantity = quantity;
-    trans.price = book.price;
-    trans.total = total;
-    trans.user_id = state.getCurrentUserId();
-    trans.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+Money buy_book(Storage& storage, SystemState& state, const std::string& isbn, int quantity){
+    return buy_books(storage, state, std::vector<std::pair<std::string, int>>(1, std::make_pair(isbn, quantity)));
+}
+Money buy_books(Storage& storage, SystemState& state, const std::vector<std::pair<std::string, int>>& items){
+    const Money failed(-1);
+    if (state.getCurrentPrivilege() < 1) return failed;
+    if (items.empty()) return failed;
+    // 同一ISBN出现多次时合并数量，按ISBN顺序成交
+    std::map<std::string, int> cart;
+    for (const auto& item : items){
+        if (!valid_isbn(item.first) || item.second <= 0) return failed;
+        int& quantity = cart[item.first];
+        if (quantity > INT_MAX - item.second) return failed;
+        quantity += item.second;
+    }
+    std::vector<std::string> keys;
+    for (const auto& item : cart) keys.push_back("book:" + item.first);
+    // 检查库存到扣减库存期间持有这些书的记录锁，同一本书的并发购买不会超卖，不同的书互不阻塞
+    Storage::KeyGuard guard = storage.lock_keys(keys);
+    std::vector<Book> books;
+    std::vector<int> quantities;
+    for (const auto& item : cart){
+        Book book = storage.load_book(item.first);
+        if (!book.valid() || book.quantity < item.second) return failed;
+        books.push_back(book);
+        quantities.push_back(item.second);
+    }
+    long long timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
         std::chrono::system_clock::now().time_since_epoch()
     ).count();
-    if (!storage.save_transaction(trans)){
-        book.quantity += quantity;
-        storage.save_book(book);
-        return -1.0;
+    Money total;
+    std::vector<Transaction> transactions;
+    for (size_t i = 0; i < books.size(); i++){
+        Transaction trans;
+        trans.trans_id = generate_trans_id();
+        trans.type = "buy";
+        trans.isbn = books[i].isbn;
+        trans.quantity = quantities[i];
+        trans.price = books[i].price;
+        trans.total = books[i].price * quantities[i];
+        trans.user_id = state.getCurrentUserId();
+        trans.timestamp = timestamp;
+        transactions.push_back(trans);
+        total += trans.total;
+        books[i].quantity -= quantities[i];
+    }
+    // 任何一步失败都把已扣减的库存加回去
+    auto restore = [&](size_t count){
+        for (size_t i = 0; i < count; i++){
+            books[i].quantity += quantities[i];
+            storage.save_book(books[i]);
+        }
+    };
+    for (size_t i = 0; i < books.size(); i++){
+        if (!storage.save_book(books[i])){
+            restore(i);
+            return failed;
+        }
+    }
+    if (!storage.save_transactions(transactions)){
+        restore(books.size());
+        return failed;
     }
     return total;
 }
@@ -5,15 +5,16 @@
 #include <sstream>
 #include <iomanip>
 #include "storage.h"
+#include "money.h"
 
 struct Book{
     std::string isbn;
     std::string name;
     std::string author;
     std::vector<std::string> keywords;
-    double price;
+    Money price;
     int quantity;
-    Book() : price(0.0), quantity(0) {}
+    Book() : quantity(0) {}
     bool valid() const {
         return !isbn.empty();
     }
@@ -23,9 +24,14 @@ struct Book{
 };
 
 std::vector<Book> show_books(Storage& storage, const std::string& condition_type = "", const std::string& condition_value = "");
+// 多个筛选条件同时满足（AND），只取 page 指定的一页
+std::vector<Book> show_books(Storage& storage, const std::vector<std::pair<std::string, std::string>>& conditions,
+                             const PageRange& page = PageRange());
 bool select_book(Storage& storage, SystemState& state, const std::string& isbn);
 bool modify_book(Storage& storage, SystemState& state, const std::vector<std::pair<std::string, std::string>>& modifications);
-bool import_book(Storage& storage, SystemState& state, int quantity, double total_cost);
-double buy_book(Storage& storage, SystemState& state, const std::string& isbn, int quantity);
+bool import_book(Storage& storage, SystemState& state, int quantity, Money total_cost);
+Money buy_book(Storage& storage, SystemState& state, const std::string& isbn, int quantity);
+// 一次购买多本书：全部库存充足才成交，否则一本也不买。返回总金额，失败时返回 Money(-1)
+Money buy_books(Storage& storage, SystemState& state, const std::vector<std::pair<std::string, int>>& items);
 
 #endif
@@ -4,239 +4,590 @@
 #include "book.h"
 #include "transaction.h"
 #include "utils.h"
+#include "output.h"
 #include <iostream>
-#include <sstream>
 #include <algorithm>
+#include <mutex>
+#include <condition_variable>
 
 extern Storage storage;
-ParsedCommand parse_command(const std::string& line){
-    ParsedCommand cmd;
-    std::string trimmed = trim(line);
-    if (trimmed.empty()){
-        return cmd;
-    }
-    std::stringstream ss(trimmed);
-    std::string token;
-    std::vector<std::string> tokens;
-    // 分割所有token
-    while (ss >> token){
-        tokens.push_back(token);
-    }
-    if (tokens.empty()){
-        return cmd;
-    }
-    cmd.name = tokens[0];
-    if (cmd.name == "show" && tokens.size() > 1 && tokens[1] == "finance"){
-        cmd.args.push_back("finance");
-        if (tokens.size() > 2){
-            cmd.args.push_back(tokens[2]);
+
+static std::vector<SystemState*> sessions;
+
+// 批处理期间其它会话的命令延后执行：它们既不应看到未提交的修改，也不能混进这一批写入
+static std::mutex batch_mutex;
+static std::condition_variable batch_changed;
+static const SystemState* batch_owner = nullptr;
+static int running_commands = 0;
+
+static void end_batch(const SystemState* state, bool commit, bool& success){
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    if (batch_owner != state){
+        success = false;
+        return;
+    }
+    success = commit ? storage.commit_batch() : storage.abort_batch();
+    batch_owner = nullptr;
+    batch_changed.notify_all();
+}
+
+std::mutex& sessions_lock(){
+    static std::mutex lock;
+    return lock;
+}
+
+void register_session(SystemState* state){
+    std::lock_guard<std::mutex> lock(sessions_lock());
+    sessions.push_back(state);
+}
+
+void unregister_session(SystemState* state){
+    bool aborted;
+    end_batch(state, false, aborted);
+    std::lock_guard<std::mutex> lock(sessions_lock());
+    sessions.erase(std::remove(sessions.begin(), sessions.end(), state), sessions.end());
+}
+
+bool is_logged_in(const std::string& user_id){
+    std::lock_guard<std::mutex> lock(sessions_lock());
+    for (SystemState* state : sessions){
+        for (const auto& entry : state->login_stack){
+            if (entry.user_id == user_id) return true;
+        }
+    }
+    return false;
+}
+
+void update_selected_isbn_all_sessions(const std::string& old_isbn, const std::string& new_isbn){
+    std::lock_guard<std::mutex> lock(sessions_lock());
+    if (old_isbn == new_isbn) return;
+    for (SystemState* state : sessions){
+        for (auto& entry : state->login_stack){
+            if (entry.selected_isbn == old_isbn){
+                entry.selected_isbn = new_isbn;
+            }
         }
-        return cmd;
     }
-    for (size_t i = 1; i < tokens.size(); i++){
-        std::string arg = tokens[i];
+}
+
+static bool parse_int(StrView text, int& value){
+    try {
+        value = std::stoi(text.str());
+    } catch(...) {
+        return false;
+    }
+    return true;
+}
+
+// 从 -from= / -to= 选项构造时间窗，出现其他选项或格式错误时返回false
+static bool parse_window(const ParsedCommand& cmd, TimeWindow& window){
+    for (size_t i = 0; i < cmd.option_count(); i++){
+        StrView key = cmd.option_key(i);
+        if (key == "from"){
+            if (!parse_time(cmd.option_value(i).str(), false, window.from)) return false;
+        } else if (key == "to"){
+            if (!parse_time(cmd.option_value(i).str(), true, window.to)) return false;
+        } else {
+            return false;
+        }
+    }
+    return window.from <= window.to;
+}
+
+static bool is_space(char c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// 按长度与首字母分派的命令名查找，每个名字最多比较一次
+static CommandType lookup_command(StrView name){
+    if (name.empty()) return CMD_EMPTY;
+    switch (name.size){
+        case 2:
+            if (name == "su") return CMD_SU;
+            break;
+        case 3:
+            if (name == "buy") return CMD_BUY;
+            if (name == "log") return CMD_LOG;
+            break;
+        case 5:
+            if (name == "begin") return CMD_BEGIN;
+            if (name == "abort") return CMD_ABORT;
+            break;
+        case 4:
+            if (name == "quit" || name == "exit") return CMD_QUIT;
+            if (name == "show") return CMD_SHOW;
+            break;
+        case 6:
+            switch (name[0]){
+                case 'l': if (name == "logout") return CMD_LOGOUT; break;
+                case 'p': if (name == "passwd") return CMD_PASSWD; break;
+                case 'd': if (name == "delete") return CMD_DELETE; break;
+                case 's': if (name == "select") return CMD_SELECT; break;
+                case 'm': if (name == "modify") return CMD_MODIFY; break;
+                case 'i': if (name == "import") return CMD_IMPORT; break;
+                case 'r': if (name == "report") return CMD_REPORT; break;
+                case 'c': if (name == "commit") return CMD_COMMIT; break;
+            }
+            break;
+        case 7:
+            if (name == "useradd") return CMD_USERADD;
+            break;
+        case 8:
+            if (name == "register") return CMD_REGISTER;
+            if (name == "checkout") return CMD_CHECKOUT;
+            break;
+    }
+    return CMD_UNKNOWN;
+}
+
+void parse_command(ParsedCommand& cmd){
+    const std::string& line = cmd.line;
+    cmd.clear();
+    size_t pos = 0, n = line.size();
+    bool first = true;
+    bool show_finance = false;
+    while (true){
+        while (pos < n && is_space(line[pos])) pos++;
+        if (pos >= n) break;
+        size_t begin = pos;
+        while (pos < n && !is_space(line[pos])) pos++;
+        ParsedCommand::Slice token(begin, pos - begin);
+        if (first){
+            cmd.set_name(token);
+            cmd.type = lookup_command(cmd.name());
+            first = false;
+            continue;
+        }
+        if (cmd.type == CMD_SHOW && cmd.arg_count() == 0 && cmd.option_count() == 0 && !show_finance
+            && StrView(line.data() + begin, token.length) == "finance"){
+            // show finance 只取一个计数参数，其余位置参数忽略
+            show_finance = true;
+            cmd.add_arg(token);
+            continue;
+        }
         // 检查是否是选项（以-开头且包含=）
-        if (arg[0] == '-' && arg.find('=') != std::string::npos){
-            size_t pos = arg.find('=');
-            std::string key = arg.substr(1, pos - 1);
-            std::string value = arg.substr(pos + 1);
+        const char* eq = line[begin] == '-'
+                         ? static_cast<const char*>(std::memchr(line.data() + begin, '=', token.length))
+                         : nullptr;
+        if (eq != nullptr){
+            size_t eq_pos = eq - line.data();
+            ParsedCommand::Slice key(begin + 1, eq_pos - begin - 1);
+            ParsedCommand::Slice value(eq_pos + 1, pos - eq_pos - 1);
             // 去除引号
-            if (!value.empty() && value.front() == '"' && value.back() == '"'){
-                value = value.substr(1, value.size() - 2);
+            if (value.length > 0 && line[value.offset] == '"' && line[pos - 1] == '"'){
+                value = value.length == 1 ? ParsedCommand::Slice(value.offset + 1, 0)
+                                          : ParsedCommand::Slice(value.offset + 1, value.length - 2);
             }
-            cmd.options[key] = value;
-        } else {
-            cmd.args.push_back(arg);
+            cmd.set_option(key, value);
+        } else if (!show_finance || cmd.arg_count() < 2){
+            cmd.add_arg(token);
         }
     }
+}
 
+ParsedCommand parse_command(const std::string& line){
+    ParsedCommand cmd;
+    cmd.line = line;
+    parse_command(cmd);
     return cmd;
 }
 
-bool execute(const ParsedCommand& cmd, SystemState& state){
-    if (cmd.name.empty()){
-        return true;
+static bool exec_empty(const ParsedCommand&, SystemState&){
+    return true;
+}
+
+static bool exec_unknown(const ParsedCommand&, SystemState&){
+    return false;
+}
+
+static bool exec_quit(const ParsedCommand&, SystemState& state){
+    state.should_exit = true;
+    return true;
+}
+
+static bool exec_su(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 1 || cmd.arg_count() == 2){
+        std::string user_id = cmd.arg(0).str();
+        std::string password = cmd.arg_count() == 2 ? cmd.arg(1).str() : "";
+        return login_user(storage, state, user_id, password);
     }
-    if (cmd.name == "quit" || cmd.name == "exit"){
-        state.should_exit = true;
-        return true;
+    return false;
+}
+
+static bool exec_logout(const ParsedCommand&, SystemState& state){
+    return logout_user(state);
+}
+
+static bool exec_register(const ParsedCommand& cmd, SystemState&){
+    if (cmd.arg_count() == 3){
+        return register_user(storage, cmd.arg(0).str(), cmd.arg(1).str(), cmd.arg(2).str());
     }
-    else if (cmd.name == "su"){
-        if (cmd.args.size() == 1 || cmd.args.size() == 2){
-            std::string user_id = cmd.args[0];
-            std::string password = cmd.args.size() == 2 ? cmd.args[1] : "";
-            return login_user(storage, state, user_id, password);
+    return false;
+}
+
+static bool exec_passwd(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 2 || cmd.arg_count() == 3){
+        std::string user_id = cmd.arg(0).str();
+        std::string old_passwd = "";
+        std::string new_passwd = "";
+        if (cmd.arg_count() == 2) {
+            if (state.getCurrentPrivilege() != 7) return false;
+            new_passwd = cmd.arg(1).str();
+        } else {
+            old_passwd = cmd.arg(1).str();
+            new_passwd = cmd.arg(2).str();
         }
+        return change_password(storage, state, user_id, old_passwd, new_passwd);
     }
-    else if (cmd.name == "logout"){
-        return logout_user(state);
+    return false;
+}
+
+static bool exec_useradd(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 4){
+        int privilege;
+        if (!parse_int(cmd.arg(2), privilege)) return false;
+        if (privilege != 1 && privilege != 3 && privilege != 7) return false;
+        return add_user(storage, state, cmd.arg(0).str(), cmd.arg(1).str(), privilege, cmd.arg(3).str());
     }
-    else if (cmd.name == "register"){
-        if (cmd.args.size() == 3){
-            return register_user(storage, cmd.args[0], cmd.args[1], cmd.args[2]);
-        }
+    return false;
+}
+
+static bool exec_delete(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 1){
+        return delete_user(storage, state, cmd.arg(0).str());
     }
-    else if (cmd.name == "passwd"){
-        if (cmd.args.size() == 2 || cmd.args.size() == 3){
-            std::string user_id = cmd.args[0];
-            std::string old_passwd = "";
-            std::string new_passwd = "";
-            if (cmd.args.size() == 2) {
-                if (state.getCurrentPrivilege() != 7) return false;
-                new_passwd = cmd.args[1];
-            } else if (cmd.args.size() == 3) {
-                old_passwd = cmd.args[1];
-                new_passwd = cmd.args[2];
-            }
-            return change_password(storage, state, user_id, old_passwd, new_passwd);
-        }
+    return false;
+}
+
+static bool exec_show_finance(const ParsedCommand& cmd, SystemState& state){
+    if (state.getCurrentPrivilege() < 7) return false;
+    if (cmd.arg_count() == 1 && cmd.option_count() > 0){
+        // show finance -from=... -to=...；给出笔数时同原来一样不看选项
+        TimeWindow window;
+        if (!parse_window(cmd, window)) return false;
+        show_finance(storage, window);
+        return true;
     }
-    else if (cmd.name == "useradd"){
-        if (cmd.args.size() == 4){
-            int privilege;
-            try {
-                privilege = std::stoi(cmd.args[2]);
-            } catch(...) {
-                return false;
-            }
-            if (privilege != 1 && privilege != 3 && privilege != 7) return false;
-            return add_user(storage, state, cmd.args[0], cmd.args[1], privilege, cmd.args[3]);
-        }
+    int count = -1;
+    if (cmd.arg_count() > 1){
+        if (!parse_int(cmd.arg(1), count)) return false;
+    }
+    if (count > 0){
+        int total_trans = storage.get_transaction_count();
+        if (count > total_trans) return false;
     }
-    else if (cmd.name == "delete"){
-        if (cmd.args.size() == 1){
-            return delete_user(storage, state, cmd.args[0]);
+    show_finance(storage, count);
+    return true;
+}
+
+// 每本书一行：ISBN、书名、作者、关键词（用|分隔）、价格、库存；无符合条件的书则输出空行
+static void render_books(const std::vector<Book>& books, std::string& text){
+    text.clear();
+    if (books.empty()){
+        text += '\n';
+        return;
+    }
+    char price[24];
+    for (const auto& book : books){
+        text += book.isbn;
+        text += '\t';
+        text += book.name;
+        text += '\t';
+        text += book.author;
+        text += '\t';
+        for (size_t i = 0; i < book.keywords.size(); i++){
+            if (i > 0) text += '|';
+            text += book.keywords[i];
         }
+        text += '\t';
+        text.append(price, format_money(book.price, price));
+        text += '\t';
+        text += std::to_string(book.quantity);
+        text += '\n';
     }
-    else if (cmd.name == "show"){
-        // 处理 show finance
-        if (!cmd.args.empty() && cmd.args[0] == "finance"){
-            if (state.getCurrentPrivilege() < 7) return false;
-            int count = -1;
-            if (cmd.args.size() > 1){
-                try {
-                    count = std::stoi(cmd.args[1]);
-                } catch(...) {
-                    return false;
-                }
-            }
-            if (count > 0){
-                int total_trans = (int)storage.get_all_transactions().size();
-                if (count > total_trans) return false;
-            }
-            show_finance(storage, count);
-            return true;
+}
+
+static bool exec_show(const ParsedCommand& cmd, SystemState& state){
+    // 处理 show finance
+    if (cmd.arg_count() > 0 && cmd.arg(0) == "finance"){
+        return exec_show_finance(cmd, state);
+    }
+    //show book
+    if (state.getCurrentPrivilege() < 1) return false;
+    // 多个筛选条件取交集；没有筛选条件时显示所有图书。
+    // 除精确匹配外，书名、作者还可以按子串（-name-contains=）或前缀（-name-prefix=）查询。
+    // -limit= / -offset= 只显示其中一页，-after= 从上一页末尾给出的游标处继续
+    std::vector<std::pair<std::string, std::string>> conditions;
+    PageRange page;
+    std::string key;
+    std::vector<std::string> tags;
+    bool search = false;
+    for (size_t i = 0; i < cmd.option_count(); i++){
+        StrView type = cmd.option_key(i);
+        if (cmd.option_value(i).empty()) return false;
+        if (i > 0) key += '\n';
+        key += Storage::show_tag(type.str(), cmd.option_value(i).str());
+        if (type == "limit" || type == "offset"){
+            int number;
+            if (!parse_int(cmd.option_value(i), number) || number < (type == "limit" ? 1 : 0)) return false;
+            (type == "limit" ? page.limit : page.offset) = number;
+            continue;
         }
-        else {
-            //show book
-            if (state.getCurrentPrivilege() < 1) return false;
-            std::vector<Book> books;
-            // 如果没有选项，显示所有图书
-            if (cmd.options.empty() && cmd.args.empty()){
-                books = show_books(storage);
-            }
-            else if (!cmd.options.empty()){
-                // 确保只有一个筛选条件
-                if (cmd.options.size() > 1) return false;
-                auto it = cmd.options.begin();
-                std::string condition_type = it->first;
-                std::string condition_value = it->second;
-                if (condition_value.empty()) return false;
-                if (condition_type == "ISBN"){
-                    books = show_books(storage, "ISBN", condition_value);
-                } else if (condition_type == "name"){
-                    books = show_books(storage, "name", condition_value);
-                } else if (condition_type == "author"){
-                    books = show_books(storage, "author", condition_value);
-                } else if (condition_type == "keyword"){
-                    books = show_books(storage, "keyword", condition_value);
-                } else {
-                    return false;
-                }
-            } else {
-                return false;
-            }
-            if (books.empty()){
-                std::cout << std::endl; // 无符合条件的书则输出空行
-            } else {
-                for (const auto& book : books){
-                    std::cout << book.isbn << "\t" << book.name << "\t" << book.author << "\t";
-                    // 输出关键词，用|分隔
-                    for (size_t i = 0; i < book.keywords.size(); i++){
-                        if (i > 0) std::cout << "|";
-                        std::cout << book.keywords[i];
-                    }
-                    std::cout << "\t" << format_double(book.price)
-                              << "\t" << book.quantity << std::endl;
-                }
-            }
-            return true;
+        if (type == "after"){
+            if (!decode_cursor(cmd.option_value(i).str(), page.after)) return false;
+            continue;
+        }
+        conditions.push_back(std::make_pair(type.str(), cmd.option_value(i).str()));
+        if (type == "ISBN" || type == "name" || type == "author" || type == "keyword"){
+            tags.push_back(Storage::show_tag(conditions.back().first, conditions.back().second));
+        } else if (type == "name-contains" || type == "name-prefix"){
+            tags.push_back(Storage::show_tag("search", "name"));
+            search = true;
+        } else if (type == "author-contains" || type == "author-prefix"){
+            tags.push_back(Storage::show_tag("search", "author"));
+            search = true;
+        } else {
+            return false;
         }
     }
-    else if (cmd.name == "buy"){
-        if (cmd.args.size() == 2){
-            if (state.getCurrentPrivilege() < 1) return false;
-            std::string isbn = cmd.args[0];
-            int quantity;
-            try {
-                quantity = std::stoi(cmd.args[1]);
-            } catch(...) {
-                return false;
-            }
-            double total = buy_book(storage, state, isbn, quantity);
-            if (total >= 0){
-                std::cout << format_double(total) << std::endl;
-                return true;
-            }
+    if (conditions.empty()){
+        if (cmd.arg_count() > 0) return false;
+        if (page.unbounded()) key = "all";
+        tags.push_back("all");
+    }
+    // 结果中的每本书满足全部条件，它的任一属性标签失效都会使这一项失效。
+    // 子串、前缀条件另外带上结果中每本书的ISBN标签，这些书的价格、库存变化时失效
+    std::string text;
+    unsigned long long generation;
+    if (!storage.show_results().get(key, text, generation)){
+        // 多取一本，用来判断后面是否还有结果
+        PageRange probe = page;
+        if (probe.limit > 0) probe.limit++;
+        std::vector<Book> books = show_books(storage, conditions, probe);
+        bool more = page.limit > 0 && (long long)books.size() > page.limit;
+        if (more) books.pop_back();
+        if (search){
+            for (const auto& book : books) tags.push_back(Storage::show_tag("ISBN", book.isbn));
         }
+        render_books(books, text);
+        // 还有下一页时，最后一行给出续页游标
+        if (more) text += "next=" + encode_cursor(books.back().isbn) + "\n";
+        storage.show_results().put(key, text, tags, generation);
     }
-    else if (cmd.name == "select"){
-        if (cmd.args.size() == 1){
-            if (state.getCurrentPrivilege() < 3) return false;
-            return select_book(storage, state, cmd.args[0]);
+    output() << text;
+    return true;
+}
+
+static bool exec_buy(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 2){
+        if (state.getCurrentPrivilege() < 1) return false;
+        int quantity;
+        if (!parse_int(cmd.arg(1), quantity)) return false;
+        Money total = buy_book(storage, state, cmd.arg(0).str(), quantity);
+        if (total.cents >= 0){
+            output() << format_money(total) << '\n';
+            return true;
         }
     }
-    else if (cmd.name == "modify"){
+    return false;
+}
+
+// checkout [ISBN] [Quantity] ([ISBN] [Quantity])...：整单购买，输出总金额
+static bool exec_checkout(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 0 || cmd.arg_count() % 2 != 0 || cmd.option_count() != 0) return false;
+    if (state.getCurrentPrivilege() < 1) return false;
+    std::vector<std::pair<std::string, int>> items;
+    for (size_t i = 0; i < cmd.arg_count(); i += 2){
+        int quantity;
+        if (!parse_int(cmd.arg(i + 1), quantity)) return false;
+        items.push_back(std::make_pair(cmd.arg(i).str(), quantity));
+    }
+    Money total = buy_books(storage, state, items);
+    if (total.cents < 0) return false;
+    output() << format_money(total) << '\n';
+    return true;
+}
+
+// begin：开始批处理，之后的写入在 commit 时一起落盘，abort 时整体撤销。
+// 撤销只针对存储的数据，登录栈与选中的图书保持不变
+static bool exec_begin(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() != 0 || cmd.option_count() != 0) return false;
+    if (state.getCurrentPrivilege() < 3) return false;
+    std::unique_lock<std::mutex> lock(batch_mutex);
+    if (batch_owner != nullptr) return false;
+    batch_owner = &state;
+    // 等其它会话正在执行的命令结束，之后它们的命令都会等到本批结束
+    batch_changed.wait(lock, []{ return running_commands == 1; });
+    if (!storage.begin_batch()){
+        batch_owner = nullptr;
+        batch_changed.notify_all();
+        return false;
+    }
+    return true;
+}
+
+static bool exec_commit(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() != 0 || cmd.option_count() != 0) return false;
+    bool success;
+    end_batch(&state, true, success);
+    return success;
+}
+
+static bool exec_abort(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() != 0 || cmd.option_count() != 0) return false;
+    bool success;
+    end_batch(&state, false, success);
+    return success;
+}
+
+static bool exec_select(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 1){
         if (state.getCurrentPrivilege() < 3) return false;
-        if (state.getSelectedIsbn().empty()) return false;
-        if (cmd.options.empty()) return false;
-        std::vector<std::pair<std::string, std::string>> modifications;
-        for (const auto& opt : cmd.options){
-            modifications.push_back({opt.first, opt.second});
-        }
-        return modify_book(storage, state, modifications);
-    }
-    else if (cmd.name == "import"){
-        if (cmd.args.size() == 2){
-            if (state.getCurrentPrivilege() < 3) return false;
-            int quantity;
-            double total_cost;
-            try {
-                quantity = std::stoi(cmd.args[0]);
-                total_cost = std::stod(cmd.args[1]);
-            } catch(...) {
-                return false;
-            }
-            return import_book(storage, state, quantity, total_cost);
-        }
+        return select_book(storage, state, cmd.arg(0).str());
+    }
+    return false;
+}
+
+static bool exec_modify(const ParsedCommand& cmd, SystemState& state){
+    if (state.getCurrentPrivilege() < 3) return false;
+    if (state.getSelectedIsbn().empty()) return false;
+    if (cmd.option_count() == 0) return false;
+    std::vector<std::pair<std::string, std::string>> modifications;
+    for (size_t i = 0; i < cmd.option_count(); i++){
+        modifications.push_back({cmd.option_key(i).str(), cmd.option_value(i).str()});
     }
-    else if (cmd.name == "report"){
-        if (cmd.args.size() == 1){
-            if (state.getCurrentPrivilege() < 7) return false;
+    return modify_book(storage, state, modifications);
+}
 
-            if (cmd.args[0] == "finance"){
-                report_finance(storage);
-                return true;
-            } else if (cmd.args[0] == "employee"){
-                report_employee(storage, state);
-                return true;
-            }
+static bool exec_import(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 2){
+        if (state.getCurrentPrivilege() < 3) return false;
+        int quantity;
+        Money total_cost;
+        if (!parse_int(cmd.arg(0), quantity)) return false;
+        if (!parse_money(cmd.arg(1).str(), total_cost)) return false;
+        return import_book(storage, state, quantity, total_cost);
+    }
+    return false;
+}
+
+static bool exec_report(const ParsedCommand& cmd, SystemState& state){
+    if (cmd.arg_count() == 1){
+        if (state.getCurrentPrivilege() < 7) return false;
+
+        StrView kind = cmd.arg(0);
+        if (kind == "finance"){
+            TimeWindow window;
+            if (!parse_window(cmd, window)) return false;
+            report_finance(storage, window);
+            return true;
+        } else if (kind == "employee"){
+            report_employee(storage);
+            return true;
+        } else if (kind == "bestseller"){
+            report_bestseller(storage, 10);
+            return true;
+        } else if (kind == "daily"){
+            TimeWindow window;
+            if (!parse_window(cmd, window)) return false;
+            report_daily(storage, window);
+            return true;
         }
     }
-    else if (cmd.name == "log"){
+    else if (cmd.arg_count() == 2 && cmd.arg(0) == "bestseller"){
+        // report bestseller [Count]
+        if (state.getCurrentPrivilege() < 7) return false;
+        int count;
+        if (!parse_int(cmd.arg(1), count)) return false;
+        if (count <= 0) return false;
+        report_bestseller(storage, count);
+        return true;
+    }
+    else if (cmd.arg_count() == 2 && cmd.arg(0) == "sales"){
+        // report sales [ISBN]
         if (state.getCurrentPrivilege() < 7) return false;
-        report_log(storage);
+        std::string isbn = cmd.arg(1).str();
+        if (!valid_isbn(isbn)) return false;
+        report_sales(storage, isbn);
+        return true;
+    }
+    else if (cmd.arg_count() == 2 && cmd.arg(0) == "employee"){
+        // report employee [UserID]：只输出指定员工
+        if (state.getCurrentPrivilege() < 7) return false;
+        std::string user_id = cmd.arg(1).str();
+        User user = storage.load_user(user_id);
+        if (!user.valid() || user.privilege < 3) return false;
+        report_employee(storage, user_id);
         return true;
     }
     return false;
 }
+
+static bool exec_log(const ParsedCommand& cmd, SystemState& state){
+    if (state.getCurrentPrivilege() < 7) return false;
+    TimeWindow window;
+    if (!parse_window(cmd, window)) return false;
+    report_log(storage, window);
+    return true;
+}
+
+typedef bool (*CommandHandler)(const ParsedCommand&, SystemState&);
+
+// 按 CommandType 下标排列
+static const CommandHandler command_table[CMD_COUNT] = {
+    exec_empty,
+    exec_unknown,
+    exec_quit,
+    exec_su,
+    exec_logout,
+    exec_register,
+    exec_passwd,
+    exec_useradd,
+    exec_delete,
+    exec_show,
+    exec_buy,
+    exec_select,
+    exec_modify,
+    exec_import,
+    exec_report,
+    exec_log,
+    exec_checkout,
+    exec_begin,
+    exec_commit,
+    exec_abort,
+};
+
+// 调用前已在 batch_mutex 下计入 running_commands
+static bool run_command(const ParsedCommand& cmd, SystemState& state){
+    bool success = command_table[cmd.type](cmd, state);
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex);
+        running_commands--;
+    }
+    batch_changed.notify_all();
+    return success;
+}
+
+bool execute(const ParsedCommand& cmd, SystemState& state){
+    {
+        std::unique_lock<std::mutex> lock(batch_mutex);
+        batch_changed.wait(lock, [&]{ return batch_owner == nullptr || batch_owner == &state; });
+        running_commands++;
+    }
+    return run_command(cmd, state);
+}
+
+bool try_execute(const ParsedCommand& cmd, SystemState& state, bool& success){
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex);
+        if (batch_owner != nullptr && batch_owner != &state) return false;
+        running_commands++;
+    }
+    success = run_command(cmd, state);
+    return true;
+}
+
+bool batch_held_by_other(const SystemState* state){
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    return batch_owner != nullptr && batch_owner != state;
+}
@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstring>
+#include <mutex>
 struct LoginEntry{
     std::string user_id;
     int privilege;
@@ -11,6 +13,10 @@ struct LoginEntry{
         : user_id(id), privilege(priv), selected_isbn("") {}
 };
 
+// 保护所有会话登录栈的锁：其它会话会读取登录栈（删除用户）或改写选中的 ISBN（修改 ISBN），
+// 因此改动栈本身、读写选中项都要持有它
+std::mutex& sessions_lock();
+
 struct SystemState{
     std::vector<LoginEntry> login_stack; //登录栈
     bool should_exit;
@@ -29,9 +35,11 @@ struct SystemState{
     }
     void push_login(const std::string& user_id, int privilege){
         LoginEntry entry(user_id, privilege);
+        std::lock_guard<std::mutex> lock(sessions_lock());
         login_stack.push_back(entry);
     }
     bool pop_login(){
+        std::lock_guard<std::mutex> lock(sessions_lock());
         if (!login_stack.empty()){
             login_stack.pop_back();
             return true;
@@ -39,44 +47,163 @@ struct SystemState{
         return false;
     }
     void clear_selected(){
+        std::lock_guard<std::mutex> lock(sessions_lock());
         if (!login_stack.empty()){
             login_stack.back().selected_isbn.clear();
         }
     }
     std::string getSelectedIsbn() const {
+        std::lock_guard<std::mutex> lock(sessions_lock());
         if (!login_stack.empty()){
             return login_stack.back().selected_isbn;
         }
         return "";
     }
     void setSelectedIsbn(const std::string& isbn){
+        std::lock_guard<std::mutex> lock(sessions_lock());
         if (!login_stack.empty()){
             login_stack.back().selected_isbn = isbn;
         }
     }
-    void updateSelectedIsbnAll(const std::string& old_isbn, const std::string& new_isbn){
-        if (old_isbn == new_isbn) return;
-        for (auto& entry : login_stack){
-            if (entry.selected_isbn == old_isbn){
-                entry.selected_isbn = new_isbn;
-            }
-        }
+};
+
+// 在线会话登记。服务器模式下多个会话共享同一份数据，
+// 删除用户、修改 ISBN 时要看到所有会话的登录栈，而不只是当前会话
+void register_session(SystemState* state);
+// 注销会话；会话仍有未提交的批处理时整批放弃
+void unregister_session(SystemState* state);
+bool is_logged_in(const std::string& user_id);
+void update_selected_isbn_all_sessions(const std::string& old_isbn, const std::string& new_isbn);
+
+// 指向某段字符的只读视图，不拥有内存
+struct StrView{
+    const char* data;
+    size_t size;
+    StrView() : data(""), size(0) {}
+    StrView(const char* d, size_t n) : data(d), size(n) {}
+    bool empty() const { return size == 0; }
+    char operator[](size_t i) const { return data[i]; }
+    std::string str() const { return std::string(data, size); }
+    bool operator==(const StrView& other) const {
+        return size == other.size && std::memcmp(data, other.data, size) == 0;
     }
+    bool operator!=(const StrView& other) const { return !(*this == other); }
+    bool operator==(const char* s) const {
+        return std::strlen(s) == size && std::memcmp(data, s, size) == 0;
+    }
+    bool operator!=(const char* s) const { return !(*this == s); }
+};
+
+enum CommandType{
+    CMD_EMPTY,
+    CMD_UNKNOWN,
+    CMD_QUIT,
+    CMD_SU,
+    CMD_LOGOUT,
+    CMD_REGISTER,
+    CMD_PASSWD,
+    CMD_USERADD,
+    CMD_DELETE,
+    CMD_SHOW,
+    CMD_BUY,
+    CMD_SELECT,
+    CMD_MODIFY,
+    CMD_IMPORT,
+    CMD_REPORT,
+    CMD_LOG,
+    CMD_CHECKOUT,
+    CMD_BEGIN,
+    CMD_COMMIT,
+    CMD_ABORT,
+    CMD_COUNT
 };
 
+const int INLINE_ARGS = 8;      // 常见命令的参数与选项个数都在此以内，不需要堆分配
+
 struct ParsedCommand{
-    std::string name;
-    std::vector<std::string> args;
-    std::map<std::string, std::string> options; //用于存储查询时的组合
-    ParsedCommand() {};
+    // 命令行内的一段：[offset, offset + length)，用偏移而非指针，复制后依然有效
+    struct Slice{
+        size_t offset;
+        size_t length;
+        Slice() : offset(0), length(0) {}
+        Slice(size_t o, size_t l) : offset(o), length(l) {}
+    };
+    struct Option{
+        Slice key;
+        Slice value;
+    };
+
+    std::string line;   // 命令原文，所有切片都指向它
+    CommandType type;
+
+    ParsedCommand() : type(CMD_EMPTY), arg_total(0), option_total(0) {}
     void clear(){
-        name.clear();
-        args.clear();
-        options.clear();
+        type = CMD_EMPTY;
+        name_slice = Slice();
+        arg_total = 0;
+        option_total = 0;
+        extra_args.clear();
+        extra_options.clear();
+    }
+
+    StrView name() const { return view(name_slice); }
+    size_t arg_count() const { return arg_total; }
+    StrView arg(size_t i) const {
+        return view(i < INLINE_ARGS ? inline_args[i] : extra_args[i - INLINE_ARGS]);
+    }
+    size_t option_count() const { return option_total; }
+    StrView option_key(size_t i) const { return view(option_at(i).key); }
+    StrView option_value(size_t i) const { return view(option_at(i).value); }
+
+    void set_name(Slice slice){ name_slice = slice; }
+    void add_arg(Slice slice){
+        if (arg_total < INLINE_ARGS) inline_args[arg_total] = slice;
+        else extra_args.push_back(slice);
+        arg_total++;
+    }
+    // 同名选项以最后一次出现为准
+    void set_option(Slice key, Slice value){
+        for (size_t i = 0; i < option_total; i++){
+            if (view(option_at(i).key) == view(key)){
+                option_at(i).value = value;
+                return;
+            }
+        }
+        Option option;
+        option.key = key;
+        option.value = value;
+        if (option_total < INLINE_ARGS) inline_options[option_total] = option;
+        else extra_options.push_back(option);
+        option_total++;
+    }
+
+private:
+    Slice name_slice;
+    Slice inline_args[INLINE_ARGS];
+    size_t arg_total;
+    std::vector<Slice> extra_args;
+    Option inline_options[INLINE_ARGS];
+    size_t option_total;
+    std::vector<Option> extra_options;
+
+    StrView view(const Slice& slice) const { return StrView(line.data() + slice.offset, slice.length); }
+    const Option& option_at(size_t i) const {
+        return i < INLINE_ARGS ? inline_options[i] : extra_options[i - INLINE_ARGS];
+    }
+    Option& option_at(size_t i){
+        return i < INLINE_ARGS ? inline_options[i] : extra_options[i - INLINE_ARGS];
     }
 };
 
+// 解析 cmd.line，复用 cmd 已有的缓冲区
+void parse_command(ParsedCommand& cmd);
 ParsedCommand parse_command(const std::string& line);
+// 执行一条命令。其它会话正在批处理时等到该批结束
 bool execute(const ParsedCommand& cmd, SystemState& state);
+// 同 execute，但其它会话正在批处理时不等待，直接返回 false（命令未执行）；
+// 执行了则返回 true，结果放在 success 中。服务器用它避免工作线程被批处理占住
+bool try_execute(const ParsedCommand& cmd, SystemState& state, bool& success);
+// 是否有其它会话正在批处理
+bool batch_held_by_other(const SystemState* state);
 
 #endif
@@ -4,44 +4,109 @@
 #include "command.h"
 #include "storage.h"
 #include "utils.h"
+#include "output.h"
+#include "CommandPipeline.hpp"
+#include "server.h"
+#include <thread>
+#include <unistd.h>
 Storage storage;
-int main(){
+
+// BOOKSTORE_FLUSH=line 每条命令后写出，=batch 输入读空时才写出；未设置时按标准输入是否为终端决定
+static FlushPolicy choose_flush_policy(){
+    const char* env = std::getenv("BOOKSTORE_FLUSH");
+    if (env != nullptr && std::string(env) == "line") return FLUSH_EACH_COMMAND;
+    if (env != nullptr && std::string(env) == "batch") return FLUSH_WHEN_IDLE;
+    return isatty(0) ? FLUSH_EACH_COMMAND : FLUSH_WHEN_IDLE;
+}
+
+static void run_command(const ParsedCommand& cmd, SystemState& state, size_t line_no, bool trace){
+    bool success = execute(cmd, state);
+    if (trace){
+        std::cerr << "[TRACE] #" << line_no
+                  << " cmd=\"" << trim(cmd.line) << "\""
+                  << " result=" << (success ? "OK" : "FAIL")
+                  << " priv=" << state.getCurrentPrivilege()
+                  << " stack=" << state.login_stack.size()
+                  << " selected=\"" << state.getSelectedIsbn() << "\""
+                  << std::endl;
+    }
+    if (!success){
+        output() << "Invalid\n";
+    }
+}
+
+// code --server [套接字路径] [--workers N]：以服务器模式运行，否则从标准输入读取命令
+int main(int argc, char** argv){
+    std::ios::sync_with_stdio(false);
 
     if (!storage.initialize()){
         std::cerr << "Fail to initialize!" << std::endl;
         return 1;
     }
 
+    if (argc > 1 && std::string(argv[1]) == "--server"){
+        std::string socket_path = "bookstore.sock";
+        size_t workers = std::thread::hardware_concurrency();
+        for (int i = 2; i < argc; i++){
+            std::string arg = argv[i];
+            if (arg == "--workers" && i + 1 < argc){
+                workers = (size_t)std::atoi(argv[++i]);
+            } else {
+                socket_path = arg;
+            }
+        }
+        if (workers == 0) workers = 4;
+        return run_server(socket_path, workers);
+    }
+
     SystemState state;
+    register_session(&state);
 
-    std::string line;
     const char* trace_env = std::getenv("BOOKSTORE_TRACE");
     bool trace = (trace_env != nullptr && *trace_env != '\0');
     size_t line_no = 0;
-    while (!state.should_exit){
-        if (!getline(std::cin, line)){
-            break;
-        }
-        line_no++;
-        ParsedCommand cmd = parse_command(line);
-        bool success = execute(cmd, state);
-        if (trace){
-            std::cerr << "[TRACE] #" << line_no
-                      << " cmd=\"" << trim(line) << "\""
-                      << " result=" << (success ? "OK" : "FAIL")
-                      << " priv=" << state.getCurrentPrivilege()
-                      << " stack=" << state.login_stack.size()
-                      << " selected=\"" << state.getSelectedIsbn() << "\""
-                      << std::endl;
-        }
-        if (!success){
-            std::cout << "Invalid" << std::endl;
+    FlushPolicy policy = choose_flush_policy();
+    if (isatty(0)){
+        ParsedCommand cmd;
+        while (!state.should_exit){
+            if (policy == FLUSH_WHEN_IDLE && std::cin.rdbuf()->in_avail() <= 0){
+                output().flush();
+            }
+            if (!getline(std::cin, cmd.line)){
+                break;
+            }
+            parse_command(cmd);
+            run_command(cmd, state, ++line_no, trace);
+            if (policy == FLUSH_EACH_COMMAND){
+                output().flush();
+            }
         }
-        if (state.should_exit){
-            break;
+    } else {
+        // 批量输入：读取与解析在读线程中提前进行，这里只按顺序执行
+        CommandPipeline pipeline(0);
+        while (!state.should_exit){
+            ParsedCommand* cmd = pipeline.ready();
+            if (cmd == nullptr){
+                // 批处理模式下只在没有已解析的命令、即将等待输入时写出
+                if (policy == FLUSH_WHEN_IDLE){
+                    output().flush();
+                }
+                cmd = pipeline.wait();
+                if (cmd == nullptr){
+                    break;
+                }
+            }
+            run_command(*cmd, state, ++line_no, trace);
+            pipeline.pop();
+            if (policy == FLUSH_EACH_COMMAND){
+                output().flush();
+            }
         }
     }
 
+    // 输入结束时仍未提交的批处理整批放弃
+    unregister_session(&state);
+    output().flush();
     return 0;
 }
 // Created by Lenovo on 2025/12/13.
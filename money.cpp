@@ -0,0 +1,65 @@
+#include "money.h"
+
+bool parse_money(const std::string& str, Money& value){
+    const long long limit = 1000000000000000LL; // 1e15 分，远超任何合理金额
+    long long cents = 0;
+    size_t i = 0, n = str.size();
+    size_t int_digits = 0;
+    while (i < n && str[i] >= '0' && str[i] <= '9'){
+        cents = cents * 10 + (str[i] - '0');
+        if (cents >= limit) return false;
+        i++;
+        int_digits++;
+    }
+    cents *= 100;
+    size_t frac_digits = 0;
+    if (i < n && str[i] == '.'){
+        i++;
+        long long scale = 10;
+        while (i < n && str[i] >= '0' && str[i] <= '9'){
+            int d = str[i] - '0';
+            if (frac_digits < 2){
+                cents += d * scale;
+                scale /= 10;
+            } else if (frac_digits == 2 && d >= 5){
+                cents += 1;
+            }
+            frac_digits++;
+            i++;
+        }
+    }
+    if (i != n || int_digits + frac_digits == 0) return false;
+    value = Money(cents);
+    return true;
+}
+
+int format_money(Money value, char* buf){
+    unsigned long long v = value.cents < 0 ? 0ULL - (unsigned long long)value.cents
+                                           : (unsigned long long)value.cents;
+    char tmp[24];
+    int len = 0;
+    tmp[len++] = (char)('0' + v % 10); v /= 10;
+    tmp[len++] = (char)('0' + v % 10); v /= 10;
+    tmp[len++] = '.';
+    do {
+        tmp[len++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    int pos = 0;
+    if (value.cents < 0) buf[pos++] = '-';
+    while (len > 0) buf[pos++] = tmp[--len];
+    return pos;
+}
+
+std::string format_money(Money value){
+    char buf[24];
+    int len = format_money(value, buf);
+    return std::string(buf, len);
+}
+
+Money divide_money(Money total, int n){
+    if (n <= 0) return Money();
+    long long half = n / 2;
+    if (total.cents >= 0) return Money((total.cents + half) / n);
+    return Money(-((-total.cents + half) / n));
+}
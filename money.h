@@ -0,0 +1,31 @@
+#ifndef MONEY_H
+#define MONEY_H
+#include <string>
+
+// 以分为单位的定点金额，加减与按数量相乘都是精确的整数运算
+struct Money{
+    long long cents;
+    Money() : cents(0) {}
+    explicit Money(long long c) : cents(c) {}
+    Money operator+(const Money& other) const { return Money(cents + other.cents); }
+    Money operator-(const Money& other) const { return Money(cents - other.cents); }
+    Money operator*(long long n) const { return Money(cents * n); }
+    Money& operator+=(const Money& other){ cents += other.cents; return *this; }
+    Money& operator-=(const Money& other){ cents -= other.cents; return *this; }
+    bool operator==(const Money& other) const { return cents == other.cents; }
+    bool operator!=(const Money& other) const { return cents != other.cents; }
+    bool operator<(const Money& other) const { return cents < other.cents; }
+    bool operator<=(const Money& other) const { return cents <= other.cents; }
+    bool operator>(const Money& other) const { return cents > other.cents; }
+    bool operator>=(const Money& other) const { return cents >= other.cents; }
+};
+
+// 解析非负十进制金额（如 "12"、"12.5"、"3.333"），第三位小数四舍五入；格式非法或溢出返回false
+bool parse_money(const std::string& str, Money& value);
+// 按两位小数写入buf（至少24字节），返回写入长度，不追加'\0'
+int format_money(Money value, char* buf);
+std::string format_money(Money value);
+// total 平均分给 n 份，四舍五入到分
+Money divide_money(Money total, int n);
+
+#endif
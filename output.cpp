@@ -0,0 +1,81 @@
+#include "output.h"
+#include <cstring>
+
+OutputBuffer::OutputBuffer(FILE* f, size_t capacity) : file(f), buffer(capacity), used(0) {}
+
+OutputBuffer::~OutputBuffer(){
+    flush();
+}
+
+void OutputBuffer::write(const char* data, size_t size){
+    if (used + size > buffer.size()){
+        flush();
+        if (size > buffer.size()){
+            fwrite(data, 1, size, file);
+            return;
+        }
+    }
+    std::memcpy(&buffer[used], data, size);
+    used += size;
+}
+
+void OutputBuffer::flush(){
+    if (used > 0){
+        fwrite(&buffer[0], 1, used, file);
+        used = 0;
+    }
+    fflush(file);
+}
+
+OutputBuffer& OutputBuffer::operator<<(const char* str){
+    write(str, std::strlen(str));
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(char c){
+    if (used == buffer.size()) flush();
+    buffer[used++] = c;
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(unsigned long long value){
+    char digits[24];
+    int len = 0;
+    do {
+        digits[len++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    char text[24];
+    for (int i = 0; i < len; i++) text[i] = digits[len - 1 - i];
+    write(text, len);
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(long long value){
+    if (value < 0){
+        *this << '-';
+        return *this << (0ULL - (unsigned long long)value);
+    }
+    return *this << (unsigned long long)value;
+}
+
+OutputBuffer& OutputBuffer::operator<<(Money value){
+    char text[24];
+    write(text, format_money(value, text));
+    return *this;
+}
+
+static OutputBuffer& standard_output(){
+    static OutputBuffer stdout_buffer(stdout);
+    return stdout_buffer;
+}
+
+static thread_local OutputBuffer* current_output = nullptr;
+
+OutputBuffer& output(){
+    return current_output != nullptr ? *current_output : standard_output();
+}
+
+void set_output(OutputBuffer* sink){
+    current_output = sink;
+}
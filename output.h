@@ -0,0 +1,46 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "money.h"
+
+// 带大缓冲区的输出目标，只在缓冲区写满或显式 flush() 时才真正写出
+class OutputBuffer{
+public:
+    explicit OutputBuffer(FILE* file, size_t capacity = 1 << 16);
+    ~OutputBuffer();
+
+    void write(const char* data, size_t size);
+    void flush();
+
+    OutputBuffer& operator<<(const std::string& str){ write(str.data(), str.size()); return *this; }
+    OutputBuffer& operator<<(const char* str);
+    OutputBuffer& operator<<(char c);
+    OutputBuffer& operator<<(int value){ return *this << (long long)value; }
+    OutputBuffer& operator<<(unsigned long value){ return *this << (unsigned long long)value; }
+    OutputBuffer& operator<<(long value){ return *this << (long long)value; }
+    OutputBuffer& operator<<(long long value);
+    OutputBuffer& operator<<(unsigned long long value);
+    OutputBuffer& operator<<(Money value);
+
+private:
+    FILE* file;
+    std::vector<char> buffer;
+    size_t used;
+    OutputBuffer(const OutputBuffer&);
+    OutputBuffer& operator=(const OutputBuffer&);
+};
+
+// 何时把缓冲区写出
+enum FlushPolicy{
+    FLUSH_EACH_COMMAND,     // 交互式：每条命令执行后
+    FLUSH_WHEN_IDLE         // 批处理：输入缓冲读空、缓冲区写满或退出时
+};
+
+// 当前线程的输出目标，默认是标准输出
+OutputBuffer& output();
+// 把当前线程的输出重定向到 sink，传入nullptr恢复为标准输出
+void set_output(OutputBuffer* sink);
+
+#endif
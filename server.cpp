@@ -0,0 +1,238 @@
+#include "server.h"
+#include "command.h"
+#include "output.h"
+#include "ThreadPool.hpp"
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <iostream>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// 一个客户端连接。busy 为真时会话交给了某个工作线程，分发线程不再读写它的其它字段
+struct Session{
+    int fd;
+    SystemState state;
+    std::string input;      // 已收到、尚未执行的输入
+    ParsedCommand cmd;
+    FILE* stream;
+    OutputBuffer* out;
+    bool busy;
+    bool eof;               // 对端已关闭写方向，剩余输入执行完即断开
+    bool parked;            // 其它会话正在批处理，未执行的输入留到该批结束再分发
+    bool closed;
+
+    explicit Session(int f) : fd(f), stream(nullptr), out(nullptr), busy(false), eof(false), parked(false), closed(false) {
+        int out_fd = dup(fd);
+        if (out_fd >= 0){
+            stream = fdopen(out_fd, "w");
+            if (stream == nullptr) close(out_fd);
+        }
+        if (stream != nullptr){
+            out = new OutputBuffer(stream);
+        }
+    }
+    ~Session(){
+        delete out;
+        if (stream != nullptr) fclose(stream);
+        close(fd);
+    }
+    bool has_line() const {
+        return input.find('\n') != std::string::npos || (eof && !input.empty());
+    }
+};
+
+static int wake_fds[2] = {-1, -1};
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop(int){
+    stop_requested = 1;
+    char c = 0;
+    ssize_t ignored = write(wake_fds[1], &c, 1);
+    (void)ignored;
+}
+
+static void wake_dispatcher(){
+    char c = 1;
+    ssize_t ignored = write(wake_fds[1], &c, 1);
+    (void)ignored;
+}
+
+// 在工作线程中执行会话已收到的所有完整行，行的切分与 getline 一致。
+// 遇到其它会话的批处理时不等待，留下这一行及之后的输入并标记 parked，把工作线程让给批处理的会话
+static void serve(Session* session){
+    set_output(session->out);
+    size_t begin = 0;
+    while (!session->state.should_exit && begin < session->input.size()){
+        size_t newline = session->input.find('\n', begin);
+        if (newline == std::string::npos && !session->eof) break;
+        size_t end = (newline == std::string::npos) ? session->input.size() : newline;
+        session->cmd.line.assign(session->input, begin, end - begin);
+        parse_command(session->cmd);
+        // 不同会话的命令并发执行，由 Storage 的记录锁与内部锁保证一致
+        bool success;
+        if (!try_execute(session->cmd, session->state, success)){
+            session->parked = true;
+            break;
+        }
+        begin = (newline == std::string::npos) ? end : newline + 1;
+        if (!success){
+            output() << "Invalid\n";
+        }
+    }
+    session->input.erase(0, begin);
+    output().flush();
+    set_output(nullptr);
+    if (session->state.should_exit || (session->eof && !session->parked)){
+        session->closed = true;
+    }
+}
+
+static int open_listener(const std::string& socket_path){
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) return -1;
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(socket_path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_server(const std::string& socket_path, size_t workers){
+    int listen_fd = open_listener(socket_path);
+    if (listen_fd < 0){
+        std::cerr << "Fail to listen on " << socket_path << std::endl;
+        return 1;
+    }
+    if (pipe(wake_fds) < 0){
+        close(listen_fd);
+        return 1;
+    }
+    fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    std::vector<Session*> sessions;
+    std::mutex done_mutex;
+    std::vector<Session*> done;     // 工作线程执行完毕、等待分发线程收回的会话
+    {
+        ThreadPool pool(workers);
+        auto dispatch = [&](Session* session){
+            session->busy = true;
+            pool.submit([session, &done_mutex, &done](){
+                serve(session);
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    done.push_back(session);
+                }
+                wake_dispatcher();
+            });
+        };
+
+        std::vector<pollfd> fds;
+        std::vector<Session*> polled;
+        std::vector<char> chunk(1 << 16);
+        while (!stop_requested){
+            fds.clear();
+            polled.clear();
+            pollfd pfd;
+            pfd.events = POLLIN;
+            pfd.fd = wake_fds[0];
+            fds.push_back(pfd);
+            pfd.fd = listen_fd;
+            fds.push_back(pfd);
+            for (Session* session : sessions){
+                if (session->busy || session->eof) continue;
+                pfd.fd = session->fd;
+                fds.push_back(pfd);
+                polled.push_back(session);
+            }
+            if (poll(&fds[0], fds.size(), -1) < 0){
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            if (fds[0].revents & POLLIN){
+                char drain[64];
+                while (read(wake_fds[0], drain, sizeof(drain)) > 0) {}
+                std::vector<Session*> finished;
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    finished.swap(done);
+                }
+                for (Session* session : finished){
+                    session->busy = false;
+                    if (session->closed){
+                        unregister_session(&session->state);
+                        sessions.erase(std::find(sessions.begin(), sessions.end(), session));
+                        delete session;
+                    } else if (!session->parked && session->has_line()){
+                        dispatch(session);
+                    }
+                }
+                // 批处理只会在某个会话的命令执行完或会话关闭后结束，此时重新分发被搁置的会话
+                for (Session* session : sessions){
+                    if (session->parked && !session->busy && !batch_held_by_other(&session->state)){
+                        session->parked = false;
+                        dispatch(session);
+                    }
+                }
+            }
+
+            if (fds[1].revents & POLLIN){
+                int client = accept(listen_fd, nullptr, nullptr);
+                if (client >= 0){
+                    Session* session = new Session(client);
+                    if (session->out == nullptr){
+                        delete session;
+                    } else {
+                        sessions.push_back(session);
+                        register_session(&session->state);
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < polled.size(); i++){
+                if (fds[i + 2].revents == 0) continue;
+                Session* session = polled[i];
+                ssize_t n = read(session->fd, &chunk[0], chunk.size());
+                if (n < 0 && errno == EINTR) continue;
+                if (n > 0){
+                    session->input.append(&chunk[0], n);
+                } else {
+                    session->eof = true;
+                }
+                if (!session->parked && (session->has_line() || session->eof)){
+                    dispatch(session);
+                }
+            }
+        }
+        // 析构线程池时执行完已提交的命令
+    }
+
+    for (Session* session : sessions){
+        unregister_session(&session->state);
+        delete session;
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    return 0;
+}
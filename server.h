@@ -0,0 +1,10 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include <string>
+
+// 服务器模式：在 Unix 域套接字 socket_path 上接受连接，每个连接是一个独立的会话（有自己的登录栈），
+// 命令由 workers 个工作线程执行，所有会话共享同一个 Storage。
+// 收到 SIGINT/SIGTERM 后停止接受连接，执行完已收到的命令再返回。失败时返回非 0
+int run_server(const std::string& socket_path, size_t workers);
+
+#endif
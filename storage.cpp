@@ -2,20 +2,73 @@
 #include "user.h"
 #include "book.h"
 #include "transaction.h"
+#include <cstdlib>
+#include <set>
 
+// 索引格式版本，与 meta:built 中记录的不同时重建
+static const char* BOOK_INDEX_VERSION = "3";
+
+// BOOKSTORE_BOOK_SHARDS=N 把图书库分成 N 个分片（与现有布局不同时启动时重新分布）；未设置时沿用现有布局
+static size_t book_shard_count(){
+    const char* env = std::getenv("BOOKSTORE_BOOK_SHARDS");
+    if (env == nullptr) return 0;
+    int count = std::atoi(env);
+    return count > 0 && count <= 64 ? count : 0;
+}
 
 Storage::Storage() :
+        journal("batch.journal"),
         user_db("users.db"),
-        book_db("books.db"),
-        trans_db("transactions.db"),
-        finance_db("finance.db"),
-        data_dir(".") {}
+        book_db("books.db", book_shard_count()),
+        index_db("book_index.db"),
+        trans_log("transactions"),
+        finance_index("finance.idx"),
+        trans_columns("trans_columns"),
+        employee_index("employee_index.db"),
+        sales_db("sales.db"),
+        data_dir("."),
+        batching(false),
+        write_blocked(false) {}
 
 Storage::~Storage() {
     cleanup();
 }
 
+Storage::KeyGuard Storage::lock_keys(const std::vector<std::string>& keys){
+    std::vector<std::string> sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    for (const auto& key : sorted){
+        KeyLock* lock;
+        {
+            // 先登记为使用者再等锁，等待期间表项不会被删去
+            std::lock_guard<std::mutex> table_lock(key_table_mutex);
+            lock = &key_table[key];
+            lock->users++;
+        }
+        lock->mutex.lock();
+    }
+    return KeyGuard(this, sorted);
+}
+
+void Storage::unlock_keys(const std::vector<std::string>& keys){
+    std::lock_guard<std::mutex> table_lock(key_table_mutex);
+    for (size_t i = keys.size(); i > 0; i--){
+        auto it = key_table.find(keys[i - 1]);
+        it->second.mutex.unlock();
+        if (--it->second.users == 0) key_table.erase(it);
+    }
+}
+
+Storage::KeyGuard Storage::lock_key(const std::string& key){
+    return lock_keys(std::vector<std::string>(1, key));
+}
+
 bool Storage::initialize(){
+    if (journal.failed()){
+        std::cerr << "Failed to replay batch.journal" << std::endl;
+        return false;
+    }
     User root = load_user("root");
     if (!root.valid()){
         root.id = "root";
@@ -27,11 +80,98 @@ bool Storage::initialize(){
             return false;
         }
     }
+    migrate_transactions();
+    sync_finance_index();
+    sync_transaction_columns();
+    sync_employee_index();
+    sync_sales();
+    // 索引文件缺失或来自旧版本时，从图书库重建
+    if (index_db.find("meta:built") != BOOK_INDEX_VERSION){
+        rebuild_book_index();
+    }
     return true;
 }
 
 void Storage::cleanup(){}
 
+bool Storage::begin_batch(){
+    std::lock_guard<std::recursive_mutex> user_lock(user_mutex);
+    std::vector<std::unique_lock<std::recursive_mutex>> shard_locks = book_db.lock_all();
+    std::lock_guard<std::recursive_mutex> index_lock(index_mutex);
+    std::lock_guard<std::recursive_mutex> trans_lock(trans_mutex);
+    if (batching || write_blocked) return false;
+    user_db.begin_batch();
+    book_db.begin_batch();
+    index_db.begin_batch();
+    trans_log.begin_batch();
+    finance_index.begin_batch();
+    trans_columns.begin_batch();
+    employee_index.begin_batch();
+    sales_db.begin_batch();
+    batching = true;
+    return true;
+}
+
+bool Storage::commit_batch(){
+    std::lock_guard<std::recursive_mutex> user_lock(user_mutex);
+    std::vector<std::unique_lock<std::recursive_mutex>> shard_locks = book_db.lock_all();
+    std::lock_guard<std::recursive_mutex> index_lock(index_mutex);
+    std::lock_guard<std::recursive_mutex> trans_lock(trans_mutex);
+    if (!batching) return false;
+    // 先把交易日志与各数据库文件的全部写入记进重做日志；这一步失败时文件都还没动，整批放弃。
+    // 收支前缀和与列式副本只追加，启动时由 sync_finance_index()、sync_transaction_columns() 从交易日志补齐，不必记入
+    trans_log.journal_batch(journal);
+    user_db.journal_batch(journal);
+    book_db.journal_batch(journal);
+    index_db.journal_batch(journal);
+    employee_index.journal_batch(journal);
+    sales_db.journal_batch(journal);
+    if (!journal.write()){
+        abort_batch();
+        return false;
+    }
+    batching = false;
+    bool success = trans_log.commit_batch();
+    success = finance_index.commit_batch() && success;
+    success = trans_columns.commit_batch() && success;
+    success = employee_index.commit_batch() && success;
+    success = sales_db.commit_batch() && success;
+    success = user_db.commit_batch() && success;
+    success = book_db.commit_batch() && success;
+    success = index_db.commit_batch() && success;
+    if (!success){
+        write_blocked = true;
+        return false;
+    }
+    journal.clear();
+    return true;
+}
+
+bool Storage::abort_batch(){
+    std::lock_guard<std::recursive_mutex> user_lock(user_mutex);
+    std::vector<std::unique_lock<std::recursive_mutex>> shard_locks = book_db.lock_all();
+    std::lock_guard<std::recursive_mutex> index_lock(index_mutex);
+    std::lock_guard<std::recursive_mutex> trans_lock(trans_mutex);
+    if (!batching) return false;
+    batching = false;
+    user_db.abort_batch();
+    book_db.abort_batch();
+    // 缓存中可能有批处理期间渲染的结果
+    show_cache.clear();
+    index_db.abort_batch();
+    trans_log.abort_batch();
+    finance_index.abort_batch();
+    trans_columns.abort_batch();
+    employee_index.abort_batch();
+    sales_db.abort_batch();
+    return true;
+}
+
+bool Storage::in_batch(){
+    std::lock_guard<std::recursive_mutex> trans_lock(trans_mutex);
+    return batching;
+}
+
 std::string Storage::serialize_user(const User& user){
     std::stringstream ss;
     ss << user.id << "|" << user.name << "|" << user.password << "|" << user.privilege;
@@ -74,8 +214,7 @@ std::string Storage::serialize_book(const Book& book){
         if (i > 0) ss << "@";
         ss << book.keywords[i];
     }
-    ss << "|" << std::fixed << std::setprecision(2) << book.price
-       << "|" << book.quantity;
+    ss << "|" << format_money(book.price) << "|" << book.quantity;
     return ss.str();
 }
 
@@ -121,10 +260,8 @@ Book Storage::deserialize_book(const std::string& data){
             }
             book.keywords = keywords;
         }
-        try {
-            book.price = std::stod(parts[4]);
-        } catch(...) {
-            book.price = 0.0;
+        if (!parse_money(parts[4], book.price)) {
+            book.price = Money();
         }
         try {
             book.quantity = std::stoi(parts[5]);
@@ -135,14 +272,34 @@ Book Storage::deserialize_book(const std::string& data){
     return book;
 }
 
-std::string Storage::serialize_trans(const Transaction& trans){
-    std::stringstream ss;
-    ss << trans.trans_id << "|" << trans.type << "|" << trans.isbn << "|" << trans.quantity
-       << "|" << std::fixed << std::setprecision(2) << trans.price << "|" << std::fixed
-       << std::setprecision(2) << trans.total << "|" << trans.user_id << "|" << trans.timestamp;
-    return ss.str();
+LogRecord Storage::serialize_trans(const Transaction& trans){
+    LogRecord record;
+    record.timestamp = trans.timestamp;
+    record.price = trans.price.cents;
+    record.total = trans.total.cents;
+    record.quantity = trans.quantity;
+    record.type = trans.type == "buy" ? 'b' : 'i';
+    strncpy(record.trans_id, trans.trans_id.c_str(), LOG_ID_SIZE - 1);
+    strncpy(record.isbn, trans.isbn.c_str(), LOG_ISBN_SIZE - 1);
+    strncpy(record.user_id, trans.user_id.c_str(), LOG_USER_SIZE - 1);
+    return record;
 }
 
+Transaction Storage::deserialize_trans(const LogRecord& record){
+    Transaction trans;
+    trans.seq = record.seq;
+    trans.trans_id = record.trans_id;
+    trans.type = record.type == 'b' ? "buy" : "import";
+    trans.isbn = record.isbn;
+    trans.quantity = record.quantity;
+    trans.price = Money(record.price);
+    trans.total = Money(record.total);
+    trans.user_id = record.user_id;
+    trans.timestamp = record.timestamp;
+    return trans;
+}
+
+// 旧版 transactions.db 中的文本格式记录，仅用于迁移
 Transaction Storage::deserialize_trans(const std::string& data){
     Transaction trans;
     std::vector<std::string> parts = split_string(data, '|');
@@ -151,8 +308,8 @@ Transaction Storage::deserialize_trans(const std::string& data){
         trans.type = parts[1];
         trans.isbn = parts[2];
         trans.quantity = std::stoi(parts[3]);
-        trans.price = std::stod(parts[4]);
-        trans.total = std::stod(parts[5]);
+        parse_money(parts[4], trans.price);
+        parse_money(parts[5], trans.total);
         trans.user_id = parts[6];
         trans.timestamp = std::stoll(parts[7]);
     }
@@ -160,12 +317,15 @@ Transaction Storage::deserialize_trans(const std::string& data){
 }
 
 bool Storage::save_user(const User& user){
+    std::lock_guard<std::recursive_mutex> lock(user_mutex);
+    if (write_blocked) return false;
     std::string key = "user:" + user.id;
     std::string value = serialize_user(user);
     return user_db.insert_or_update(key, value);
 }
 
 User Storage::load_user(const std::string& user_id){
+    std::lock_guard<std::recursive_mutex> lock(user_mutex);
     std::string key = "user:" + user_id;
     std::string data = user_db.find(key);
     if (data.empty()) {
@@ -175,11 +335,14 @@ User Storage::load_user(const std::string& user_id){
 }
 
 bool Storage::delete_user(const std::string& user_id){
+    std::lock_guard<std::recursive_mutex> lock(user_mutex);
+    if (write_blocked) return false;
     std::string key = "user:" + user_id;
     return user_db.remove(key);
 }
 
 std::vector<User> Storage::get_all_users(){
+    std::lock_guard<std::recursive_mutex> lock(user_mutex);
     std::vector<User> users;
     auto all = user_db.find_prefix("user:");
     for (const auto& entry : all){
@@ -189,13 +352,32 @@ std::vector<User> Storage::get_all_users(){
     return users;
 }
 
+// 书名、作者、关键词或ISBN变化时才需要改动二级索引，价格、库存的修改不必锁 index_db
+static bool index_changes(const Book& old_book, const Book& new_book){
+    return old_book.valid() != new_book.valid() || old_book.isbn != new_book.isbn || old_book.name != new_book.name
+           || old_book.author != new_book.author || old_book.keywords != new_book.keywords;
+}
+
 bool Storage::save_book(const Book& book){
+    // 同一本书的读-改-写由调用方的记录锁互斥；分片锁只在 find、insert_or_update 各自读写块时持有，
+    // 只有一个分片时，不同图书的写入也只在块读写上互斥，序列化、索引与缓存的维护不占分片锁
     std::string key = "book:" + book.isbn;
     std::string value = serialize_book(book);
-    return book_db.insert_or_update(key, value);
+    if (write_blocked) return false;
+    std::string old_data = book_db.find(key);
+    Book old_book;
+    if (!old_data.empty()) old_book = deserialize_book(old_data);
+    if (!book_db.insert_or_update(key, value)) return false;
+    if (index_changes(old_book, book)){
+        std::lock_guard<std::recursive_mutex> index_lock(index_mutex);
+        update_book_index(old_book, book);
+    }
+    invalidate_show_cache(old_book, book);
+    return true;
 }
 
 Book Storage::load_book(const std::string& isbn){
+    // 点查询只锁所在分片，不与其它分片上的读写互斥
     std::string key = "book:" + isbn;
     std::string data = book_db.find(key);
     if (data.empty()) return Book();
@@ -204,78 +386,557 @@ Book Storage::load_book(const std::string& isbn){
 
 bool Storage::delete_book(const std::string& isbn){
     std::string key = "book:" + isbn;
-    return book_db.remove(key);
+    if (write_blocked) return false;
+    std::string old_data = book_db.find(key);
+    if (old_data.empty()) return false;
+    if (!book_db.remove(key)) return false;
+    Book old_book = deserialize_book(old_data);
+    {
+        std::lock_guard<std::recursive_mutex> index_lock(index_mutex);
+        update_book_index(old_book, Book());
+    }
+    invalidate_show_cache(old_book, Book());
+    return true;
 }
 
-std::vector<Book> Storage::get_all_books(){
-    std::vector<Book> books;
-    auto all = book_db.find_prefix("book:");
-    for (const auto& entry : all){
-        Book book = deserialize_book(entry.second);
-        if (!book.isbn.empty()) {
-            // 检查是否已经存在相同ISBN的书
-            bool exists = false;
-            for (const auto& existing_book : books){
-                if (existing_book.isbn == book.isbn){
-                    exists = true;
-                    break;
-                }
+void Storage::invalidate_show_cache(const Book& old_book, const Book& new_book){
+    // 新旧两个版本涉及的查询都可能改变：结果集合变化，或结果中这本书的显示内容变化
+    std::vector<std::string> tags(1, "all");
+    for (const Book* book : {&old_book, &new_book}){
+        if (!book->valid()) continue;
+        tags.push_back(show_tag("ISBN", book->isbn));
+        tags.push_back(show_tag("name", book->name));
+        tags.push_back(show_tag("author", book->author));
+        for (const auto& kw : book->keywords){
+            tags.push_back(show_tag("keyword", kw));
+        }
+    }
+    // 子串、前缀查询无法按值列举受影响的查询，书名或作者一变就全部失效
+    if (old_book.name != new_book.name) tags.push_back(show_tag("search", "name"));
+    if (old_book.author != new_book.author) tags.push_back(show_tag("search", "author"));
+    show_cache.invalidate(tags);
+}
+
+std::string Storage::index_prefix(const std::string& field, const std::string& value){
+    return field + ":" + hash_key(value) + "|";
+}
+
+// 每个索引前缀下的条目数，用于按选择性安排求交顺序：count:<属性>:<哈希> -> 条目数
+static std::string count_key(const std::string& field, const std::string& value){
+    return "count:" + field + ":" + hash_key(value);
+}
+
+void Storage::add_index_entry(const std::string& field, const std::string& value, const std::string& isbn, int delta){
+    std::string key = index_prefix(field, value) + isbn;
+    if (delta > 0 ? !index_db.insert(key, isbn) : !index_db.remove(key)) return;
+    std::string counter = count_key(field, value);
+    long long count = index_count(field, value) + delta;
+    if (count > 0){
+        index_db.insert_or_update(counter, std::to_string(count));
+    } else {
+        index_db.remove(counter);
+    }
+}
+
+long long Storage::index_count(const std::string& field, const std::string& value){
+    std::string data = index_db.find(count_key(field, value));
+    return data.empty() ? 0 : std::stoll(data);
+}
+
+// 书名、作者的检索索引：
+//   <属性>-gram:<三元组哈希>|<ISBN>  值中每个不同的三字节子串一项，用于子串查询
+//   prefix:<属性>:<值的开头>|<ISBN>  按值的开头排序，用于前缀查询；键长有限，只保留值的前 PREFIX_KEY_BYTES 个字节
+static const size_t PREFIX_KEY_BYTES = 24;
+
+static std::string prefix_key(const std::string& field, const std::string& value){
+    return "prefix:" + field + ":" + value.substr(0, PREFIX_KEY_BYTES);
+}
+
+// 值中所有不同的三字节子串，升序
+static std::vector<std::string> trigrams(const std::string& value){
+    std::vector<std::string> grams;
+    for (size_t i = 0; i + 3 <= value.size(); i++){
+        grams.push_back(value.substr(i, 3));
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+static bool has_suffix(const std::string& str, const std::string& suffix){
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 按记录本身判定一个 (属性, 值) 条件
+static bool book_matches(const Book& book, const std::string& field, const std::string& value){
+    if (field == "ISBN") return book.isbn == value;
+    if (field == "name") return book.name == value;
+    if (field == "author") return book.author == value;
+    if (field == "keyword") return std::find(book.keywords.begin(), book.keywords.end(), value) != book.keywords.end();
+    if (field == "name-contains") return book.name.find(value) != std::string::npos;
+    if (field == "author-contains") return book.author.find(value) != std::string::npos;
+    if (field == "name-prefix") return book.name.compare(0, value.size(), value) == 0;
+    if (field == "author-prefix") return book.author.compare(0, value.size(), value) == 0;
+    return false;
+}
+
+void Storage::update_book_index(const Book& old_book, const Book& new_book){
+    // 只改动发生变化的属性，价格、库存的修改不触碰索引
+    bool same_isbn = old_book.isbn == new_book.isbn;
+    auto update_field = [&](const std::string& field, const std::string& old_value, const std::string& new_value){
+        if (same_isbn && old_value == new_value) return;
+        if (old_book.valid() && !old_value.empty()){
+            add_index_entry(field, old_value, old_book.isbn, -1);
+        }
+        if (new_book.valid() && !new_value.empty()){
+            add_index_entry(field, new_value, new_book.isbn, 1);
+        }
+        // 检索索引：三元组只增删两个版本的差集，前缀项整项替换
+        std::vector<std::string> old_grams, new_grams;
+        if (old_book.valid()) old_grams = trigrams(old_value);
+        if (new_book.valid()) new_grams = trigrams(new_value);
+        for (const auto& gram : old_grams){
+            if (!same_isbn || !std::binary_search(new_grams.begin(), new_grams.end(), gram)){
+                add_index_entry(field + "-gram", gram, old_book.isbn, -1);
             }
-            if (!exists){
-                books.push_back(book);
+        }
+        for (const auto& gram : new_grams){
+            if (!same_isbn || !std::binary_search(old_grams.begin(), old_grams.end(), gram)){
+                add_index_entry(field + "-gram", gram, new_book.isbn, 1);
             }
         }
+        if (old_book.valid() && !old_value.empty()){
+            index_db.remove(prefix_key(field, old_value) + "|" + old_book.isbn);
+        }
+        if (new_book.valid() && !new_value.empty()){
+            index_db.insert(prefix_key(field, new_value) + "|" + new_book.isbn, new_book.isbn);
+        }
+    };
+    update_field("author", old_book.author, new_book.author);
+    update_field("name", old_book.name, new_book.name);
+    for (const auto& kw : old_book.keywords){
+        if (!same_isbn || std::find(new_book.keywords.begin(), new_book.keywords.end(), kw) == new_book.keywords.end()){
+            add_index_entry("keyword", kw, old_book.isbn, -1);
+        }
     }
-    // 按ISBN升序排序
-    std::sort(books.begin(), books.end(), [](const Book& a, const Book& b){
-        return a.isbn < b.isbn;
+    for (const auto& kw : new_book.keywords){
+        if (!same_isbn || std::find(old_book.keywords.begin(), old_book.keywords.end(), kw) == old_book.keywords.end()){
+            add_index_entry("keyword", kw, new_book.isbn, 1);
+        }
+    }
+}
+
+void Storage::rebuild_book_index(){
+    // 先读出全部图书再锁 index_db，持有 index_mutex 时不读 book_db
+    std::vector<Book> books = get_all_books();
+    std::lock_guard<std::recursive_mutex> lock(index_mutex);
+    for (const auto& entry : index_db.find_all()){
+        index_db.remove(entry.first);
+    }
+    for (const auto& book : books){
+        update_book_index(Book(), book);
+    }
+    index_db.insert_or_update("meta:built", BOOK_INDEX_VERSION);
+}
+
+std::vector<Book> Storage::get_books_by_index(const std::string& field, const std::string& value){
+    std::vector<std::string> isbns;
+    {
+        std::lock_guard<std::recursive_mutex> lock(index_mutex);
+        index_db.scan_prefix(index_prefix(field, value), [&](const Record& record){
+            isbns.push_back(record.get_value());
+            return true;
+        });
+    }
+    // 同一前缀下的键按ISBN有序；取回记录后再核对属性，排除哈希冲突
+    std::vector<Book> result;
+    for (const auto& isbn : isbns){
+        Book book = load_book(isbn);
+        if (book.valid() && book_matches(book, field, value)) result.push_back(book);
+    }
+    return result;
+}
+
+std::vector<Book> Storage::get_all_books(){
+    std::vector<Book> books;
+    scan_books([&](const Book& book){
+        books.push_back(book);
+        return true;
     });
     return books;
 }
 
+void Storage::scan_books(const std::function<bool(const Book&)>& visit){
+    scan_books("", visit);
+}
+
+void Storage::scan_books(const std::string& after, const std::function<bool(const Book&)>& visit){
+    // book_db 按键有序且键唯一，扫描结果即按ISBN升序且无重复。
+    // 扫描时按分片加锁：单个分片时扫描期间不会有写入；多个分片时分块读取，两块之间可能有写入，每条记录本身完整。
+    // ISBN 只含可打印字符，"book:<after>\x01" 恰好排在 after 之后的第一个键之前
+    std::string start = after.empty() ? "book:" : "book:" + after + "\x01";
+    book_db.scan_from(start, "book:", [&](const Record& record){
+        Book book = deserialize_book(record.value);
+        if (book.isbn.empty()) return true;
+        return visit(book);
+    });
+}
+
 std::vector<Book> Storage::get_books_by_keyword(const std::string& keyword){
-    std::vector<Book> all = get_all_books();
+    return get_books_by_index("keyword", keyword);
+}
+
+std::vector<Book> Storage::get_books_by_author(const std::string& author){
+    return get_books_by_index("author", author);
+}
+
+std::vector<Book> Storage::get_books_by_name(const std::string& name){
+    return get_books_by_index("name", name);
+}
+
+// 在有序的 list[from, end) 中找第一个 >= target 的位置：先按 1, 2, 4... 的步长跳过，再在最后一步内二分
+static size_t gallop(const std::vector<std::string>& list, size_t from, const std::string& target){
+    size_t step = 1, low = from, high = from;
+    while (high < list.size() && list[high] < target){
+        low = high + 1;
+        high += step;
+        step <<= 1;
+    }
+    if (high > list.size()) high = list.size();
+    return std::lower_bound(list.begin() + low, list.begin() + high, target) - list.begin();
+}
+
+std::vector<std::string> Storage::posting_list(const std::string& field, const std::string& value){
+    std::vector<std::string> isbns;
+    if (field == "ISBN"){
+        // 是否存在由最后取回记录时核对，这里不读 book_db
+        isbns.push_back(value);
+        return isbns;
+    }
+    if (has_suffix(field, "-prefix")){
+        // 前缀索引按值排序，取出后改按ISBN排序以便求交
+        std::string base = field.substr(0, field.size() - 7);
+        index_db.scan_prefix(prefix_key(base, value), [&](const Record& record){
+            isbns.push_back(record.get_value());
+            return true;
+        });
+        std::sort(isbns.begin(), isbns.end());
+        return isbns;
+    }
+    index_db.scan_prefix(index_prefix(field, value), [&](const Record& record){
+        isbns.push_back(record.get_value());
+        return true;
+    });
+    return isbns;
+}
+
+std::vector<Book> Storage::find_books(const std::vector<std::pair<std::string, std::string>>& conditions,
+                                      const PageRange& page){
     std::vector<Book> result;
-    for (const auto& book : all){
-        for (const auto& kw : book.keywords){
-            if (kw == keyword){
-                result.push_back(book);
-                break;
+    if (page.limit == 0) return result;
+    // 结果按ISBN升序产生，凑满一页即停止，不再读取之后的图书
+    long long skip = page.offset;
+    auto take = [&](const Book& book){
+        if (skip > 0){
+            skip--;
+            return true;
+        }
+        result.push_back(book);
+        return page.limit < 0 || (long long)result.size() < page.limit;
+    };
+    // 把条件化为可求交的倒排表：精确条件与前缀条件各一张，子串条件按它的每个三元组各一张。
+    // 短于三个字节的子串没有可用的索引，只在最后核对
+    std::vector<std::pair<std::string, std::string>> terms;
+    for (const auto& condition : conditions){
+        if (has_suffix(condition.first, "-contains")){
+            std::string field = condition.first.substr(0, condition.first.size() - 9) + "-gram";
+            for (const auto& gram : trigrams(condition.second)){
+                terms.push_back(std::make_pair(field, gram));
+            }
+        } else {
+            terms.push_back(condition);
+        }
+    }
+    auto match_all = [&](const Book& book){
+        for (const auto& condition : conditions){
+            if (!book_matches(book, condition.first, condition.second)) return false;
+        }
+        return true;
+    };
+    if (terms.empty()){
+        scan_books(page.after, [&](const Book& book){
+            return !match_all(book) || take(book);
+        });
+        return result;
+    }
+    // 求交只读 index_db，在锁内完成；取回记录在锁外，持有 index_mutex 时不读 book_db
+    std::unique_lock<std::recursive_mutex> index_lock(index_mutex);
+    // 按条目数从少到多求交：先取出最短的倒排表，之后的每个条件只需检查还剩下的候选。
+    // 前缀条件没有计数，先取出它的表，以表长作为条目数
+    std::vector<std::vector<std::string>> lists(terms.size());
+    std::vector<std::pair<long long, size_t>> order;
+    for (size_t i = 0; i < terms.size(); i++){
+        const std::string& field = terms[i].first;
+        long long count;
+        if (field == "ISBN"){
+            count = 1;
+        } else if (has_suffix(field, "-prefix")){
+            lists[i] = posting_list(field, terms[i].second);
+            count = lists[i].size();
+        } else {
+            count = index_count(field, terms[i].second);
+        }
+        if (count == 0) return result;
+        order.push_back(std::make_pair(count, i));
+    }
+    std::sort(order.begin(), order.end());
+    auto take_list = [&](size_t i){
+        return has_suffix(terms[i].first, "-prefix") ? lists[i] : posting_list(terms[i].first, terms[i].second);
+    };
+    std::vector<std::string> candidates = take_list(order[0].second);
+    if (!page.after.empty()){
+        candidates.erase(candidates.begin(), std::upper_bound(candidates.begin(), candidates.end(), page.after));
+    }
+    for (size_t k = 1; k < order.size() && !candidates.empty(); k++){
+        const std::pair<std::string, std::string>& term = terms[order[k].second];
+        std::vector<std::string> kept;
+        if (has_suffix(term.first, "-prefix")
+            || (term.first != "ISBN" && order[k].first <= (long long)candidates.size() * 8)){
+            // 两表长度相近：取出整张表，用跳跃查找归并
+            std::vector<std::string> list = take_list(order[k].second);
+            size_t pos = 0;
+            for (const auto& isbn : candidates){
+                pos = gallop(list, pos, isbn);
+                if (pos == list.size()) break;
+                if (list[pos] == isbn) kept.push_back(isbn);
+            }
+        } else {
+            // 候选远少于该表的条目：逐个按键查找，不读整张表
+            std::string prefix = term.first == "ISBN" ? "" : index_prefix(term.first, term.second);
+            for (const auto& isbn : candidates){
+                bool present = term.first == "ISBN" ? isbn == term.second
+                                                    : !index_db.find(prefix + isbn).empty();
+                if (present) kept.push_back(isbn);
             }
         }
+        candidates.swap(kept);
+    }
+    index_lock.unlock();
+    // 哈希可能冲突、三元组都出现也不一定连续出现、前缀索引只存了值的开头，取回记录后逐个核对全部条件
+    for (const auto& isbn : candidates){
+        Book book = load_book(isbn);
+        if (book.valid() && match_all(book) && !take(book)) break;
     }
     return result;
 }
 
-std::vector<Book> Storage::get_books_by_author(const std::string& author){
-    std::vector<Book> all = get_all_books();
-    std::vector<Book> result;
-    for (const auto& book : all){
-        if (book.author == author){
-            result.push_back(book);
+// 汇总键：
+//   isbn:<ISBN>              -> 销量|销售额|进货量|进货额
+//   rank:<反转销量>|<ISBN>    -> ISBN，按销量降序排列
+//   day:<YYYY-MM-DD>         -> 收入|支出
+static std::string rank_key(long long units, const std::string& isbn){
+    return "rank:" + to_hex(~(unsigned long long)units, 16) + "|" + isbn;
+}
+
+static std::string day_key(long long timestamp){
+    return "day:" + format_time(timestamp).substr(0, 10);
+}
+
+static std::string sales_value(const SalesStat& stat){
+    return std::to_string(stat.units) + "|" + std::to_string(stat.revenue.cents) + "|"
+           + std::to_string(stat.import_units) + "|" + std::to_string(stat.cost.cents);
+}
+
+// 一组交易对销售汇总的增量，按ISBN、按天累计后每个汇总键只读写一次
+struct SalesDelta {
+    std::map<std::string, SalesStat> isbns;
+    std::map<std::string, std::pair<long long, long long>> days;    // 收入, 支出
+
+    void add(char type, const std::string& isbn, int quantity, long long total, long long timestamp){
+        SalesStat& stat = isbns[isbn];
+        std::pair<long long, long long>& day = days[day_key(timestamp)];
+        if (type == 'b'){
+            stat.units += quantity;
+            stat.revenue += Money(total);
+            day.first += total;
+        } else {
+            stat.import_units += quantity;
+            stat.cost += Money(total);
+            day.second += total;
         }
     }
-    return result;
-}
+};
 
 bool Storage::save_transaction(const Transaction& trans){
-    std::string key = "trans:" + trans.trans_id;
-    std::string value = serialize_trans(trans);
-    bool success = trans_db.insert(key, value);
-    if (success){
-        if (trans.type == "buy"){
-            update_finance(trans.total, 0.0);
+    return save_transactions(std::vector<Transaction>(1, trans));
+}
+
+bool Storage::save_transactions(const std::vector<Transaction>& transactions){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    if (write_blocked) return false;
+    if (transactions.empty()) return true;
+    // 日志、列式副本与收支前缀和各只写一次；销售汇总按ISBN、按天合并后每个键写一次
+    std::vector<LogRecord> records;
+    records.reserve(transactions.size());
+    for (const auto& trans : transactions){
+        records.push_back(serialize_trans(trans));
+    }
+    if (trans_log.append(&records[0], records.size()) < 0) return false;
+    size_t from = trans_columns.size();
+    std::vector<std::pair<long long, long long>> deltas;
+    SalesDelta sales;
+    for (size_t i = 0; i < records.size(); i++){
+        const LogRecord& record = records[i];
+        trans_columns.push(record.type, record.quantity, record.total, record.timestamp,
+                           transactions[i].user_id, transactions[i].isbn);
+        index_user_transaction(transactions[i].user_id, record.timestamp, record.seq);
+        sales.add(record.type, transactions[i].isbn, record.quantity, record.total, record.timestamp);
+        if (record.type == 'b'){
+            deltas.push_back(std::make_pair(record.total, 0LL));
         } else {
-            update_finance(0.0, trans.total);
+            deltas.push_back(std::make_pair(0LL, record.total));
         }
     }
-    return success;
+    update_sales(sales);
+    trans_columns.flush_rows(from);
+    finance_index.append(deltas);
+    // 最后记下高水位；中断时其后的交易由启动时的 sync_employee_index()、sync_sales() 补齐
+    set_indexed_seq(trans_log.size());
+    return true;
+}
+
+std::string Storage::indexed_seq(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    return sales_db.find("meta:seq");
+}
+
+void Storage::set_indexed_seq(long long seq){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    sales_db.insert_or_update("meta:seq", std::to_string(seq));
 }
 
 std::vector<Transaction> Storage::get_all_transactions() {
+    return get_recent_transactions(-1);
+}
+
+std::vector<Transaction> Storage::get_recent_transactions(int count){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    // 日志按发生顺序排列，最近 count 条即末尾的一段，直接按序号定位
+    long long total = trans_log.size();
+    long long from = (count <= 0 || count >= total) ? 0 : total - count;
     std::vector<Transaction> transactions;
-    auto all = trans_db.find_prefix("trans:");
-    for (const auto& entry : all){
+    transactions.reserve((size_t)(total - from));
+    trans_log.scan(from, total, [&](const LogRecord& record){
+        transactions.push_back(deserialize_trans(record));
+        return true;
+    });
+    return transactions;
+}
+
+void Storage::scan_transactions(const std::function<bool(const Transaction&)>& visit){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    trans_log.scan(0, trans_log.size(), [&](const LogRecord& record){
+        return visit(deserialize_trans(record));
+    });
+}
+
+void Storage::index_user_transaction(const std::string& user_id, long long timestamp, long long seq){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    // 键为 用户|时间戳|序号，同一用户的交易在前缀内按时间排列
+    std::string key = "emp:" + user_id + "|" + to_hex((unsigned long long)timestamp, 16) + "|" + to_hex((unsigned long long)seq, 12);
+    employee_index.insert(key, std::to_string(seq));
+}
+
+void Storage::rebuild_employee_index(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    for (const auto& entry : employee_index.find_all()){
+        employee_index.remove(entry.first);
+    }
+    const std::vector<unsigned>& users = trans_columns.user_codes();
+    const std::vector<long long>& timestamps = trans_columns.timestamps();
+    for (size_t i = 0; i < users.size(); i++){
+        index_user_transaction(trans_columns.user_dictionary().decode(users[i]), timestamps[i], (long long)i);
+    }
+    employee_index.insert_or_update("meta:built", "1");
+}
+
+void Storage::sync_employee_index(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    // 没有高水位时无从判断缺了哪些，整体重建；高水位由随后的 sync_sales() 更新
+    std::string mark = indexed_seq();
+    if (employee_index.find("meta:built").empty() || mark.empty()){
+        rebuild_employee_index();
+        return;
+    }
+    // 写入交易时中断，高水位之后的交易可能缺项；从列式副本补齐，已有的键插入时被忽略
+    const std::vector<unsigned>& users = trans_columns.user_codes();
+    const std::vector<long long>& timestamps = trans_columns.timestamps();
+    size_t from = (size_t)std::stoll(mark);
+    if (from >= users.size()) return;
+    for (size_t i = from; i < users.size(); i++){
+        index_user_transaction(trans_columns.user_dictionary().decode(users[i]), timestamps[i], (long long)i);
+    }
+}
+
+std::vector<long long> Storage::get_user_transaction_seqs(const std::string& user_id){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    std::vector<long long> seqs;
+    employee_index.scan_prefix("emp:" + user_id + "|", [&](const Record& record){
+        seqs.push_back(std::stoll(record.value));
+        return true;
+    });
+    return seqs;
+}
+
+std::vector<Transaction> Storage::get_transactions_by_user(const std::string& user_id){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    std::vector<Transaction> transactions;
+    for (long long seq : get_user_transaction_seqs(user_id)){
+        LogRecord record;
+        if (trans_log.read(seq, record)) transactions.push_back(deserialize_trans(record));
+    }
+    return transactions;
+}
+
+void Storage::scan_transactions(const TimeWindow& window, const std::function<bool(const Transaction&)>& visit){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    std::pair<long long, long long> range = trans_log.time_window(window.from, window.to);
+    trans_log.scan(range.first, range.second, [&](const LogRecord& record){
+        if (!window.contains(record.timestamp)) return true;
+        return visit(deserialize_trans(record));
+    });
+}
+
+size_t Storage::scan_transactions(const TimeWindow& window, size_t parts,
+                                  const std::function<bool(size_t, const Transaction&)>& visit){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    std::pair<long long, long long> range = trans_log.time_window(window.from, window.to);
+    return trans_log.parallel_scan(range.first, range.second, parts, [&](size_t part, const LogRecord& record){
+        if (!window.contains(record.timestamp)) return true;
+        return visit(part, deserialize_trans(record));
+    });
+}
+
+std::pair<long long, long long> Storage::transaction_seq_range(const TimeWindow& window){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    return trans_log.time_window(window.from, window.to);
+}
+
+int Storage::get_transaction_count(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    return (int)trans_log.size();
+}
+
+void Storage::migrate_transactions(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    // 旧版本把交易存放在 transactions.db 中，日志为空时按时间顺序导入一次
+    if (trans_log.size() > 0) return;
+    std::ifstream test("transactions.db");
+    if (!test.good()) return;
+    test.close();
+    BlockListDB old_db("transactions.db");
+    std::vector<Transaction> transactions;
+    for (const auto& entry : old_db.find_prefix("trans:")){
         Transaction trans = deserialize_trans(entry.second);
         if (!trans.trans_id.empty()) transactions.push_back(trans);
     }
@@ -283,66 +944,246 @@ std::vector<Transaction> Storage::get_all_transactions() {
         if (a.timestamp != b.timestamp) return a.timestamp < b.timestamp;
         return a.trans_id < b.trans_id;
     });
-    return transactions;
+    for (const auto& trans : transactions){
+        LogRecord record = serialize_trans(trans);
+        trans_log.append(record);
+    }
 }
 
-std::vector<Transaction> Storage::get_recent_transactions(int count){
-    std::vector<Transaction> all = get_all_transactions();
-    if (count <= 0 || count >= (int)all.size()){
-        return all;
+void Storage::update_finance(Money income, Money expense){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    finance_index.append(income.cents, expense.cents);
+}
+
+std::pair<Money, Money> Storage::get_finance_summary(int count){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    if (count == 0){
+        return make_pair(Money(), Money());
     }
-    std::vector<Transaction> result;
-    for (int i = (int)all.size() - count; i < (int)all.size(); i++){
-        result.push_back(all[i]);
+    long long total = finance_index.size();
+    if (count < 0 || count >= total){
+        FinanceEntry entry = finance_index.total();
+        return make_pair(Money(entry.income), Money(entry.expense));
     }
-    return result;
+    std::pair<long long, long long> sums = finance_index.range(total - count, total);
+    return make_pair(Money(sums.first), Money(sums.second));
+}
+
+std::pair<Money, Money> Storage::get_finance_summary(const TimeWindow& window){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    // 稀疏索引项整段落在时间窗内的连续区间直接用前缀和相减，只逐条读取边界上的段
+    std::pair<long long, long long> range = trans_log.time_window(window.from, window.to);
+    const std::vector<LogIndexEntry>& index = trans_log.index();
+    long long income = 0, expense = 0;
+    long long run_begin = -1;
+    auto flush_run = [&](long long run_end){
+        if (run_begin < 0) return;
+        std::pair<long long, long long> sums = finance_index.range(run_begin, run_end);
+        income += sums.first;
+        expense += sums.second;
+        run_begin = -1;
+    };
+    for (long long seq = range.first; seq < range.second; seq += LOG_INDEX_STRIDE){
+        const LogIndexEntry& entry = index[(size_t)(seq / LOG_INDEX_STRIDE)];
+        long long end = std::min(seq + LOG_INDEX_STRIDE, range.second);
+        if (window.contains(entry.min_timestamp) && window.contains(entry.max_timestamp)){
+            if (run_begin < 0) run_begin = seq;
+            continue;
+        }
+        flush_run(seq);
+        trans_log.scan(seq, end, [&](const LogRecord& record){
+            if (window.contains(record.timestamp)){
+                if (record.type == 'b') income += record.total;
+                else expense += record.total;
+            }
+            return true;
+        });
+    }
+    flush_run(range.second);
+    return make_pair(Money(income), Money(expense));
+}
+
+void Storage::sync_finance_index(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    // 前缀和落后于日志时（首次升级或写入中断）从日志补齐
+    long long from = finance_index.size();
+    if (from >= trans_log.size()) return;
+    trans_log.scan(from, trans_log.size(), [&](const LogRecord& record){
+        if (record.type == 'b'){
+            update_finance(Money(record.total), Money());
+        } else {
+            update_finance(Money(), Money(record.total));
+        }
+        return true;
+    });
+}
+
+void Storage::sync_transaction_columns(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    long long from = (long long)trans_columns.size();
+    if (from >= trans_log.size()) return;
+    trans_log.scan(from, trans_log.size(), [&](const LogRecord& record){
+        trans_columns.append(record.type, record.quantity, record.total, record.timestamp,
+                             record.user_id, record.isbn);
+        return true;
+    });
 }
 
-void Storage::update_finance(double income, double expense){
-    std::string current = finance_db.find("summary");
-    double total_income = 0.0, total_expense = 0.0;
-    if (!current.empty()){
-        std::vector<std::string> parts = split_string(current, '|');
+void Storage::update_sales(const SalesDelta& delta){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    for (const auto& entry : delta.isbns){
+        const std::string& isbn = entry.first;
+        SalesStat stat = get_sales(isbn);
+        long long old_units = stat.units;
+        stat.units += entry.second.units;
+        stat.revenue += entry.second.revenue;
+        stat.import_units += entry.second.import_units;
+        stat.cost += entry.second.cost;
+        sales_db.insert_or_update("isbn:" + isbn, sales_value(stat));
+        if (stat.units != old_units){
+            if (old_units > 0) sales_db.remove(rank_key(old_units, isbn));
+            sales_db.insert(rank_key(stat.units, isbn), isbn);
+        }
+    }
+    for (const auto& entry : delta.days){
+        long long income = 0, expense = 0;
+        std::vector<std::string> parts = split_string(sales_db.find(entry.first), '|');
         if (parts.size() >= 2){
-            total_income = std::stod(parts[0]);
-            total_expense = std::stod(parts[1]);
+            income = std::stoll(parts[0]);
+            expense = std::stoll(parts[1]);
         }
+        income += entry.second.first;
+        expense += entry.second.second;
+        sales_db.insert_or_update(entry.first, std::to_string(income) + "|" + std::to_string(expense));
     }
-    total_income += income;
-    total_expense += expense;
-    std::string new_value = to_string(total_income) + "|" + to_string(total_expense);
-    finance_db.insert_or_update("summary", new_value);
 }
 
-std::pair<double, double> Storage::get_finance_summary(int count){
-    if (count == 0){
-        return make_pair(0.0, 0.0);
+void Storage::rebuild_sales(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    for (const auto& entry : sales_db.find_all()){
+        sales_db.remove(entry.first);
+    }
+    SalesDelta delta;
+    for (size_t i = 0; i < trans_columns.size(); i++){
+        delta.add(trans_columns.types()[i], trans_columns.isbn_dictionary().decode(trans_columns.isbn_codes()[i]),
+                  trans_columns.quantities()[i], trans_columns.totals()[i], trans_columns.timestamps()[i]);
+    }
+    update_sales(delta);
+    sales_db.insert("meta:built", "1");
+    set_indexed_seq((long long)trans_columns.size());
+}
+
+void Storage::sync_sales(){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    std::string mark = indexed_seq();
+    if (sales_db.find("meta:built").empty() || mark.empty()){
+        rebuild_sales();
+        return;
+    }
+    size_t from = (size_t)std::stoll(mark);
+    size_t to = trans_columns.size();
+    if (from >= to) return;
+    // 高水位之后的交易可能已有一部分计入了汇总，不能在现有值上再累加。
+    // 这些交易涉及的ISBN与日期按全部交易重新合计后覆盖写入
+    const std::vector<char>& types = trans_columns.types();
+    const std::vector<int>& quantities = trans_columns.quantities();
+    const std::vector<long long>& totals = trans_columns.totals();
+    const std::vector<long long>& timestamps = trans_columns.timestamps();
+    const std::vector<unsigned>& isbn_codes = trans_columns.isbn_codes();
+    std::map<unsigned, SalesStat> stats;
+    std::map<std::string, std::pair<long long, long long>> days;
+    for (size_t i = from; i < to; i++){
+        stats[isbn_codes[i]];
+        days[day_key(timestamps[i])];
     }
-    if (count < 0){
-        std::string current = finance_db.find("summary");
-        if (current.empty()){
-            return make_pair(0.0, 0.0);
+    for (size_t i = 0; i < to; i++){
+        auto stat = stats.find(isbn_codes[i]);
+        if (stat != stats.end()){
+            if (types[i] == 'b'){
+                stat->second.units += quantities[i];
+                stat->second.revenue += Money(totals[i]);
+            } else {
+                stat->second.import_units += quantities[i];
+                stat->second.cost += Money(totals[i]);
+            }
         }
-        std::vector<std::string> parts = split_string(current, '|');
-        if (parts.size() < 2){
-            return make_pair(0.0, 0.0);
+        auto day = days.find(day_key(timestamps[i]));
+        if (day != days.end()){
+            if (types[i] == 'b') day->second.first += totals[i];
+            else day->second.second += totals[i];
         }
-        return make_pair(std::stod(parts[0]), std::stod(parts[1]));
     }
-    std::vector<Transaction> transactions;
-    transactions = get_recent_transactions(count);
-    double total_income = 0.0, total_expense = 0.0;
-    for (const auto& trans : transactions){
-        if (trans.type == "buy"){
-            total_income += trans.total;
-        } else if (trans.type == "import"){
-            total_expense += trans.total;
-        }
+    // 排名项中的旧销量无从得知，先删去这些ISBN的全部排名项
+    std::set<std::string> isbns;
+    for (const auto& entry : stats) isbns.insert(trans_columns.isbn_dictionary().decode(entry.first));
+    std::vector<std::string> stale;
+    sales_db.scan_prefix("rank:", [&](const Record& record){
+        if (isbns.count(record.get_value()) > 0) stale.push_back(record.get_index());
+        return true;
+    });
+    for (const auto& key : stale) sales_db.remove(key);
+    for (auto& entry : stats){
+        const std::string& isbn = trans_columns.isbn_dictionary().decode(entry.first);
+        sales_db.insert_or_update("isbn:" + isbn, sales_value(entry.second));
+        if (entry.second.units > 0) sales_db.insert(rank_key(entry.second.units, isbn), isbn);
+    }
+    for (const auto& entry : days){
+        sales_db.insert_or_update(entry.first, std::to_string(entry.second.first) + "|" + std::to_string(entry.second.second));
     }
-    return make_pair(total_income, total_expense);
+    set_indexed_seq((long long)to);
+}
+
+SalesStat Storage::get_sales(const std::string& isbn){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    SalesStat stat;
+    stat.isbn = isbn;
+    std::vector<std::string> parts = split_string(sales_db.find("isbn:" + isbn), '|');
+    if (parts.size() >= 4){
+        stat.units = std::stoll(parts[0]);
+        stat.revenue = Money(std::stoll(parts[1]));
+        stat.import_units = std::stoll(parts[2]);
+        stat.cost = Money(std::stoll(parts[3]));
+    }
+    return stat;
+}
+
+std::vector<SalesStat> Storage::get_bestsellers(int count){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    std::vector<std::string> isbns;
+    sales_db.scan_prefix("rank:", [&](const Record& record){
+        isbns.push_back(record.get_value());
+        return (int)isbns.size() < count;
+    });
+    std::vector<SalesStat> result;
+    for (const auto& isbn : isbns){
+        result.push_back(get_sales(isbn));
+    }
+    return result;
+}
+
+std::vector<DailyStat> Storage::get_daily_totals(const TimeWindow& window){
+    std::lock_guard<std::recursive_mutex> lock(trans_mutex);
+    std::string first_day = window.from == LLONG_MIN ? "" : format_time(window.from).substr(0, 10);
+    std::string last_day = window.to == LLONG_MAX ? "" : format_time(window.to).substr(0, 10);
+    std::vector<DailyStat> result;
+    sales_db.scan_from("day:" + first_day, "day:", [&](const Record& record){
+        DailyStat stat;
+        stat.date = record.get_index().substr(4);
+        if (!last_day.empty() && stat.date > last_day) return false;
+        std::vector<std::string> parts = split_string(record.get_value(), '|');
+        if (parts.size() >= 2){
+            stat.income = Money(std::stoll(parts[0]));
+            stat.expense = Money(std::stoll(parts[1]));
+        }
+        result.push_back(stat);
+        return true;
+    });
+    return result;
 }
 
 bool Storage::save_state(const SystemState& state){
+    std::lock_guard<std::recursive_mutex> lock(user_mutex);
+    if (write_blocked) return false;
     std::stringstream ss;
     ss << state.login_stack.size() << std::endl;
     for (const auto& entry : state.login_stack){
@@ -354,6 +1195,7 @@ bool Storage::save_state(const SystemState& state){
 }
 
 bool Storage::load_state(SystemState& state){
+    std::lock_guard<std::recursive_mutex> lock(user_mutex);
     std::string data = user_db.find("system_state");
     if (data.empty()) return false;
     std::stringstream ss(data);
@@ -4,57 +4,182 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include "BatchJournal.hpp"
 #include "BlockListDB.hpp"
+#include "ShardedDB.hpp"
+#include "TransactionLog.hpp"
+#include "FinanceIndex.hpp"
+#include "TransactionColumns.hpp"
+#include "ShowCache.hpp"
 #include "command.h"
 #include "utils.h"
+#include "money.h"
 
 struct User;
 struct Book;
 struct Transaction;
 struct SystemState;
+struct SalesStat;
+struct SalesDelta;
+struct DailyStat;
 
 class Storage {
 private:
+    BatchJournal journal;       // 批处理的重做日志，须在各数据库打开文件之前构造（重做上次未完成的提交）
     BlockListDB user_db;
-    BlockListDB book_db;
-    BlockListDB trans_db;
-    BlockListDB finance_db;
+    ShardedDB book_db;          // 按ISBN分片，分片数见 BOOKSTORE_BOOK_SHARDS
+    BlockListDB index_db;   // 图书二级索引：author/name/keyword -> ISBN
+    TransactionLog trans_log;   // 交易按发生顺序追加写入
+    FinanceIndex finance_index; // 按交易序号的收支前缀和
+    TransactionColumns trans_columns;   // 交易历史的列式副本，供报表聚合
+    BlockListDB employee_index;         // (user_id, timestamp) -> 交易序号
+    BlockListDB sales_db;               // 按ISBN与按天的增量销售汇总
     std::string data_dir;
+    ShowCache show_cache;   // show 的渲染结果，图书写入时按受影响的属性失效
+
+    // 内部锁，保证每次存储操作自身是原子的；可重入，便于存储方法互相调用。
+    // book_db 的读写只在读写块时锁所在分片（ShardedDB 内部），其间不再获取其它锁。同时需要多把时按
+    // user -> 图书分片 -> index -> trans 的顺序获取，持有 index_mutex 时不再读写 book_db
+    std::recursive_mutex user_mutex;    // user_db
+    std::recursive_mutex index_mutex;   // index_db
+    std::recursive_mutex trans_mutex;   // 交易日志及由它派生的各索引、汇总
+    // 记录锁，见 lock_keys()。表中只有正被持有或等待的键
+    struct KeyLock {
+        std::mutex mutex;
+        int users;
+        KeyLock() : users(0) {}
+    };
+    std::mutex key_table_mutex;
+    std::map<std::string, KeyLock> key_table;
+    void unlock_keys(const std::vector<std::string>& keys);
+    bool batching;
+    // 提交时有文件没写成功：重做日志留到下次启动，在此之前拒绝写入，以免重做时覆盖之后的修改
+    std::atomic<bool> write_blocked;
 
     // 序列化与反序列化
     std::string serialize_user(const User& user);
     User deserialize_user(const std::string& data);
     std::string serialize_book(const Book& book);
     Book deserialize_book(const std::string& data);
-    std::string serialize_trans(const Transaction& trans);
+    LogRecord serialize_trans(const Transaction& trans);
+    Transaction deserialize_trans(const LogRecord& record);
     Transaction deserialize_trans(const std::string& data);
+    void migrate_transactions();
+    void sync_finance_index();
+    // 收支前缀和的每一项对应日志中的一笔交易，只能由 sync_finance_index() 按日志追加
+    void update_finance(Money income, Money expense);
+    void sync_transaction_columns();
+    void index_user_transaction(const std::string& user_id, long long timestamp, long long seq);
+    void rebuild_employee_index();
+    void sync_employee_index();
+    void update_sales(const SalesDelta& delta);
+    void rebuild_sales();
+    void sync_sales();
+    // 员工索引与销售汇总共用一个高水位（已计入的交易数），记在 sales_db 的 meta:seq 中
+    std::string indexed_seq();
+    void set_indexed_seq(long long seq);
+
+    // 二级索引维护与查询
+    static std::string index_prefix(const std::string& field, const std::string& value);
+    void update_book_index(const Book& old_book, const Book& new_book);
+    void add_index_entry(const std::string& field, const std::string& value, const std::string& isbn, int delta);
+    long long index_count(const std::string& field, const std::string& value);
+    std::vector<std::string> posting_list(const std::string& field, const std::string& value);
+    void rebuild_book_index();
+    std::vector<Book> get_books_by_index(const std::string& field, const std::string& value);
+    void invalidate_show_cache(const Book& old_book, const Book& new_book);
 
 public:
+    // 一组记录锁，析构时释放
+    class KeyGuard {
+    private:
+        Storage* owner;
+        std::vector<std::string> held;
+        KeyGuard(const KeyGuard&);
+        KeyGuard& operator=(const KeyGuard&);
+    public:
+        KeyGuard(Storage* storage, std::vector<std::string>& keys) : owner(storage) { held.swap(keys); }
+        KeyGuard(KeyGuard&& other) : owner(other.owner) { held.swap(other.held); }
+        ~KeyGuard() {
+            if (!held.empty()) owner->unlock_keys(held);
+        }
+    };
+
     Storage();
     ~Storage();
     bool initialize();
     void cleanup();
 
+    // 批处理：begin_batch() 之后的所有写入只在内存中生效（读取能看到），
+    // commit_batch() 时每个文件一次写出、一次刷新，abort_batch() 时整体丢弃。
+    // 提交先写重做日志再写各文件，中途失败或中断时下次启动按重做日志补完，整批要么都生效要么都不生效
+    bool begin_batch();
+    bool commit_batch();
+    bool abort_batch();
+    bool in_batch();
+
+    // 锁住若干条记录（键同数据库中的键，如 "book:<ISBN>"、"user:<UserID>"），用于跨多次存储调用的读-改-写。
+    // 每个键一把锁：同一条记录的读-改-写互斥，不同记录互不阻塞；
+    // 按键升序加锁，一次锁多条记录也不会死锁。持有记录锁时才可以再获取内部锁，反之不行
+    KeyGuard lock_keys(const std::vector<std::string>& keys);
+    KeyGuard lock_key(const std::string& key);
+
     bool save_user(const User& user);
     User load_user(const std::string& user_id);
     bool delete_user(const std::string& user_id);
     std::vector<User> get_all_users();
 
+    // 写入图书须持有该书的记录锁（lock_key("book:<ISBN>")）
     bool save_book(const Book& book);
     Book load_book(const std::string& isbn);
     bool delete_book(const std::string& isbn);
     std::vector<Book> get_all_books();
+    void scan_books(const std::function<bool(const Book&)>& visit);
+    // 只访问 ISBN > after 的图书
+    void scan_books(const std::string& after, const std::function<bool(const Book&)>& visit);
     std::vector<Book> get_books_by_keyword(const std::string& keyword);
     std::vector<Book> get_books_by_author(const std::string& author);
+    std::vector<Book> get_books_by_name(const std::string& name);
+    // 同时满足所有 (属性, 值) 条件的图书，按ISBN升序。属性为 ISBN、name、author、keyword（精确匹配），
+    // name-contains、author-contains（子串）或 name-prefix、author-prefix（前缀）。
+    // 只返回 page 指定的一页，没有条件时按页列出全部图书
+    std::vector<Book> find_books(const std::vector<std::pair<std::string, std::string>>& conditions,
+                                 const PageRange& page = PageRange());
+
+    // show 结果缓存。标签 show_tag(属性, 值) 在该属性取该值的图书被写入时失效，"all" 在任何图书写入时失效，
+    // show_tag("search", name/author) 在任一图书的书名/作者改变时失效
+    ShowCache& show_results() { return show_cache; }
+    static std::string show_tag(const std::string& field, const std::string& value) { return field + ":" + value; }
 
     bool save_transaction(const Transaction& trans);
+    // 一次提交多笔交易，序号连续
+    bool save_transactions(const std::vector<Transaction>& transactions);
     std::vector<Transaction> get_all_transactions();
     std::vector<Transaction> get_recent_transactions(int count);
+    void scan_transactions(const std::function<bool(const Transaction&)>& visit);
+    void scan_transactions(const TimeWindow& window, const std::function<bool(const Transaction&)>& visit);
+    // 把时间窗内的交易按序号分成至多 parts 段并行访问，visit(段号, 交易) 会在多个线程中同时调用。
+    // 段号小的段交易在前，按段号合并各段的部分结果即保持顺序。返回实际的段数
+    size_t scan_transactions(const TimeWindow& window, size_t parts,
+                             const std::function<bool(size_t, const Transaction&)>& visit);
+    std::pair<long long, long long> transaction_seq_range(const TimeWindow& window);
+    std::vector<long long> get_user_transaction_seqs(const std::string& user_id);
+    std::vector<Transaction> get_transactions_by_user(const std::string& user_id);
+    // 列式副本会随新交易追加而变化，读取期间须持有 lock_transactions() 返回的锁
+    const TransactionColumns& transaction_columns() const { return trans_columns; }
+    std::unique_lock<std::recursive_mutex> lock_transactions() { return std::unique_lock<std::recursive_mutex>(trans_mutex); }
 
-    void update_finance(double income, double expense);
-    std::pair<double, double> get_finance_summary(int count = -1);
+    std::pair<Money, Money> get_finance_summary(int count = -1);
+    std::pair<Money, Money> get_finance_summary(const TimeWindow& window);
     int get_transaction_count();
 
+    SalesStat get_sales(const std::string& isbn);
+    std::vector<SalesStat> get_bestsellers(int count);
+    std::vector<DailyStat> get_daily_totals(const TimeWindow& window);
+
     bool save_state(const SystemState& state);
     bool load_state(SystemState& state);
 };
@@ -0,0 +1,72 @@
+// 打开旧版本留下的、块不按键排序的数据文件：查找、更新、删除与 find_all 的顺序都应正确。
+// 用法：blocklist_order <临时文件路径>
+#include "../BlockListDB.hpp"
+#include <cstdio>
+
+static const int BLOCK_BYTES = sizeof(int) * 2 + INDEX_SIZE * 2 + sizeof(Record) * BLOCK_SIZE;
+
+static void write_block(ofstream& out, int next, const vector<pair<string, string>>& records) {
+    Block block;
+    for (const auto& record : records) {
+        block.records[block.record_count++] = Record(record.first, record.second);
+    }
+    block.update_boundaries();
+    block.next_block = next;
+    out.write(reinterpret_cast<const char*>(&block.record_count), sizeof(int));
+    out.write(reinterpret_cast<const char*>(&block.next_block), sizeof(int));
+    out.write(block.first_index, INDEX_SIZE);
+    out.write(block.last_index, INDEX_SIZE);
+    out.write(reinterpret_cast<const char*>(block.records), sizeof(Record) * BLOCK_SIZE);
+}
+
+static int failures = 0;
+
+static void expect(bool condition, const string& what) {
+    if (!condition) {
+        cerr << "FAIL: " << what << endl;
+        failures++;
+    }
+}
+
+static void check_order(BlockListDB& db, const vector<string>& keys, const string& stage) {
+    auto all = db.find_all();
+    vector<string> got;
+    for (const auto& entry : all) got.push_back(entry.first);
+    expect(got == keys, stage + ": find_all in key order");
+}
+
+int main(int argc, char** argv) {
+    string name = argc > 1 ? argv[1] : "blocklist_order.db";
+    std::remove(name.c_str());
+    {
+        // 链：块0 [c, d] -> 块1 [a, b] -> 块2 空 -> 块3 [b(旧值), e]
+        ofstream out(name, ios::binary);
+        int first = sizeof(int);
+        out.write(reinterpret_cast<const char*>(&first), sizeof(int));
+        write_block(out, first + BLOCK_BYTES, {{"c", "3"}, {"d", "4"}});
+        write_block(out, first + BLOCK_BYTES * 2, {{"a", "1"}, {"b", "2"}});
+        write_block(out, first + BLOCK_BYTES * 3, {});
+        write_block(out, -1, {{"b", "stale"}, {"e", "5"}});
+    }
+    {
+        BlockListDB db(name);
+        check_order(db, {"a", "b", "c", "d", "e"}, "open");
+        expect(db.find("a") == "1", "find a");
+        expect(db.find("b") == "2", "find b keeps the first copy on the chain");
+        expect(db.find("e") == "5", "find e");
+        expect(db.insert_or_update("a", "10"), "update a");
+        expect(db.find("a") == "10", "find updated a");
+        expect(!db.insert("c", "dup"), "insert existing c");
+        expect(db.remove("d"), "remove d");
+        expect(db.find("d").empty(), "d removed");
+        check_order(db, {"a", "b", "c", "e"}, "after writes");
+    }
+    {
+        BlockListDB db(name);
+        check_order(db, {"a", "b", "c", "e"}, "reopen");
+        expect(db.find("a") == "10", "reopen find a");
+    }
+    std::remove(name.c_str());
+    if (failures == 0) cout << "ok" << endl;
+    return failures == 0 ? 0 : 1;
+}
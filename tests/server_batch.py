@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+# 服务器模式下批处理不占住工作线程：
+# --workers 2，A 登录并 begin；B、C 登录后 show（在 A 的批处理结束前不能执行）；
+# A 随后 commit 并 show finance，必须得到结果而不是卡死。
+# 用法：server_batch.py <code 可执行文件>
+import os
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+TIMEOUT = 10.0
+
+
+def connect(path):
+    deadline = time.time() + TIMEOUT
+    while True:
+        try:
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            sock.connect(path)
+            sock.settimeout(TIMEOUT)
+            return sock
+        except OSError:
+            sock.close()
+            if time.time() > deadline:
+                raise
+            time.sleep(0.05)
+
+
+def read_until(sock, expected):
+    data = b""
+    while expected not in data:
+        chunk = sock.recv(4096)
+        if not chunk:
+            break
+        data += chunk
+    return data
+
+
+def main():
+    binary = os.path.abspath(sys.argv[1])
+    workdir = tempfile.mkdtemp(prefix="server_batch_")
+    path = os.path.join(workdir, "s.sock")
+    server = subprocess.Popen([binary, "--server", path, "--workers", "2"], cwd=workdir)
+    finance = b"+ 0.00 - 0.00\n"
+    ok = False
+    try:
+        a = connect(path)
+        a.sendall(b"su root sjtu\nbegin\nshow finance\n")
+        if finance not in read_until(a, finance):
+            print("begin failed")
+            return 1
+        others = [connect(path), connect(path)]
+        for sock in others:
+            sock.sendall(b"su root sjtu\nshow\nshow finance\n")
+        # 让 B、C 的命令先到达服务器，旧实现中它们会占满两个工作线程
+        time.sleep(0.5)
+        a.sendall(b"commit\nshow finance\n")
+        try:
+            got = read_until(a, finance)
+        except socket.timeout:
+            print("commit blocked: batch owner starved of workers")
+            return 1
+        if finance not in got:
+            print("unexpected reply to commit:", got)
+            return 1
+        for sock in others:
+            got = read_until(sock, finance)
+            if finance not in got:
+                print("parked session lost its commands:", got)
+                return 1
+        for sock in [a] + others:
+            sock.close()
+        ok = True
+    finally:
+        server.send_signal(signal.SIGINT)
+        try:
+            server.wait(TIMEOUT)
+        except subprocess.TimeoutExpired:
+            server.kill()
+            server.wait()
+            if ok:
+                print("server did not stop")
+                ok = False
+        shutil.rmtree(workdir, ignore_errors=True)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+# 服务器模式下多个会话并发购买不同的图书：每次购买都应成功，库存与收支分毫不差。
+# 分别以 1 个与 4 个图书分片（BOOKSTORE_BOOK_SHARDS）运行，并打印耗时供对比。
+# 用法：server_buys.py <code 可执行文件>
+import os
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+TIMEOUT = 60.0
+BOOKS = 8
+STOCK = 1000
+BUYS = 100
+PRICE = "2.50"
+
+
+def connect(path):
+    deadline = time.time() + 10
+    while True:
+        try:
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            sock.connect(path)
+            sock.settimeout(TIMEOUT)
+            return sock
+        except OSError:
+            sock.close()
+            if time.time() > deadline:
+                raise
+            time.sleep(0.05)
+
+
+def converse(path, commands):
+    """发送全部命令后关闭写方向，读到对端关闭为止"""
+    sock = connect(path)
+    sock.sendall("".join(line + "\n" for line in commands).encode())
+    sock.shutdown(socket.SHUT_WR)
+    data = b""
+    while True:
+        chunk = sock.recv(65536)
+        if not chunk:
+            break
+        data += chunk
+    sock.close()
+    return data.decode()
+
+
+def isbn(i):
+    return "978-7-%07d" % i
+
+
+def run(binary, shards):
+    workdir = tempfile.mkdtemp(prefix="server_buys_")
+    path = os.path.join(workdir, "s.sock")
+    env = dict(os.environ, BOOKSTORE_BOOK_SHARDS=str(shards))
+    server = subprocess.Popen([binary, "--server", path, "--workers", "4"], cwd=workdir, env=env)
+    errors = []
+    try:
+        setup = ["su root sjtu"]
+        for i in range(BOOKS):
+            setup += ["select " + isbn(i), "modify -price=" + PRICE, "import %d 1" % STOCK]
+        out = converse(path, setup)
+        if out.strip():
+            errors.append("setup failed: " + out)
+            return errors
+
+        results = [None] * BOOKS
+
+        def buyer(i):
+            try:
+                results[i] = converse(path, ["su root sjtu"] + ["buy %s 1" % isbn(i)] * BUYS)
+            except OSError as error:
+                results[i] = "error: %s" % error
+
+        threads = [threading.Thread(target=buyer, args=(i,)) for i in range(BOOKS)]
+        begin = time.time()
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        elapsed = time.time() - begin
+        for i, out in enumerate(results):
+            if out != (PRICE + "\n") * BUYS:
+                errors.append("buyer %d got unexpected output: %r" % (i, out[:200]))
+
+        check = ["su root sjtu", "show finance"]
+        for i in range(BOOKS):
+            check.append("show -ISBN=" + isbn(i))
+        out = converse(path, check).splitlines()
+        income = "%.2f" % (BOOKS * BUYS * float(PRICE))
+        if not out or not out[0].startswith("+ " + income + " "):
+            errors.append("finance mismatch: %r" % (out[:1],))
+        for i in range(BOOKS):
+            line = out[i + 1] if i + 1 < len(out) else ""
+            if not line.startswith(isbn(i)) or not line.endswith("\t%d" % (STOCK - BUYS)):
+                errors.append("stock mismatch for %s: %r" % (isbn(i), line))
+        print("shards=%d: %d buys on %d books in %.2fs" % (shards, BOOKS * BUYS, BOOKS, elapsed))
+    finally:
+        server.send_signal(signal.SIGINT)
+        try:
+            server.wait(10)
+        except subprocess.TimeoutExpired:
+            server.kill()
+            server.wait()
+            errors.append("server did not stop")
+        shutil.rmtree(workdir, ignore_errors=True)
+    return errors
+
+
+def main():
+    binary = os.path.abspath(sys.argv[1])
+    errors = []
+    for shards in (1, 4):
+        errors += run(binary, shards)
+    for error in errors:
+        print(error)
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -2,109 +2,229 @@
 #include "storage.h"
 #include "command.h"
 #include "utils.h"
+#include "output.h"
+#include "ThreadPool.hpp"
 #include <iostream>
 #include <iomanip>
 #include <cstdlib>
+#include <atomic>
 
 void show_finance(Storage& storage, int count) {
     if (count == 0) {
-        std::cout << std::endl;
+        output() << '\n';
         return;
     }
 
-    std::pair<double, double> finance = storage.get_finance_summary(count);
+    std::pair<Money, Money> finance = storage.get_finance_summary(count);
 
     const char* trace_env = std::getenv("BOOKSTORE_TRACE");
     if (trace_env != nullptr && *trace_env != '\0') {
-        size_t trans_count = storage.get_all_transactions().size();
+        int trans_count = storage.get_transaction_count();
         std::cerr << "[TRACE_FINANCE] count=" << count
                   << " total_trans=" << trans_count
-                  << " income=" << format_double(finance.first)
-                  << " expense=" << format_double(finance.second)
+                  << " income=" << format_money(finance.first)
+                  << " expense=" << format_money(finance.second)
                   << std::endl;
     }
 
     // 输出格式：+ [收入] - [支出]
-    std::cout << "+ " << format_double(finance.first)
-              << " - " << format_double(finance.second) << std::endl;
+    output() << "+ " << format_money(finance.first)
+             << " - " << format_money(finance.second) << '\n';
 }
 
-void report_finance(Storage& storage) {
-    std::vector<Transaction> transactions = storage.get_all_transactions();
-    std::cout << "=============================================" << std::endl;
-    std::cout << "                 财务报表" << std::endl;
-    std::cout << "=============================================" << std::endl;
-    double total_income = 0.0, total_expense = 0.0;
-    for (const auto& trans : transactions) {
-        std::cout << "交易ID: " << trans.trans_id << std::endl;
-        std::cout << "类型: " << (trans.type == "buy" ? "销售" : "进货") << std::endl;
-        std::cout << "ISBN: " << trans.isbn << std::endl;
-        std::cout << "数量: " << trans.quantity << std::endl;
-        std::cout << "单价: " << format_double(trans.price) << std::endl;
-        std::cout << "总额: " << format_double(trans.total) << std::endl;
-        std::cout << "用户: " << trans.user_id << std::endl;
-        std::cout << "时间: " << format_time(trans.timestamp) << std::endl;
-        std::cout << "---------------------------------------------" << std::endl;
-        if (trans.type == "buy") {
-            total_income += trans.total;
-        } else {
-            total_expense += trans.total;
+void report_bestseller(Storage& storage, int count) {
+    std::vector<SalesStat> stats = storage.get_bestsellers(count);
+    output() << "=============================================" << '\n';
+    output() << "                 畅销排行" << '\n';
+    output() << "=============================================" << '\n';
+    if (stats.empty()) {
+        output() << "暂无销售记录" << '\n';
+    }
+    for (size_t i = 0; i < stats.size(); i++) {
+        output() << i + 1 << ". " << stats[i].isbn
+                 << " 销量: " << stats[i].units
+                 << " 销售额: " << format_money(stats[i].revenue) << '\n';
+    }
+    output() << "=============================================" << '\n';
+}
+
+void report_sales(Storage& storage, const std::string& isbn) {
+    SalesStat stat = storage.get_sales(isbn);
+    output() << "=============================================" << '\n';
+    output() << "ISBN: " << stat.isbn << '\n';
+    output() << "销量: " << stat.units << '\n';
+    output() << "销售额: " << format_money(stat.revenue) << '\n';
+    output() << "进货量: " << stat.import_units << '\n';
+    output() << "进货额: " << format_money(stat.cost) << '\n';
+    output() << "=============================================" << '\n';
+}
+
+void report_daily(Storage& storage, const TimeWindow& window) {
+    std::vector<DailyStat> stats = storage.get_daily_totals(window);
+    output() << "=============================================" << '\n';
+    output() << "                 每日收支" << '\n';
+    output() << "=============================================" << '\n';
+    if (stats.empty()) {
+        output() << "暂无交易记录" << '\n';
+    }
+    for (const auto& stat : stats) {
+        output() << stat.date
+                 << " 收入: " << format_money(stat.income)
+                 << " 支出: " << format_money(stat.expense) << '\n';
+    }
+    output() << "=============================================" << '\n';
+}
+
+void show_finance(Storage& storage, const TimeWindow& window) {
+    std::pair<Money, Money> finance = storage.get_finance_summary(window);
+    output() << "+ " << format_money(finance.first)
+             << " - " << format_money(finance.second) << '\n';
+}
+
+void report_finance(Storage& storage, const TimeWindow& window) {
+    // 明细与合计须来自同一批交易
+    std::unique_lock<std::recursive_mutex> lock = storage.lock_transactions();
+    output() << "=============================================" << '\n';
+    output() << "                 财务报表" << '\n';
+    output() << "=============================================" << '\n';
+    // 明细需要交易ID，读一遍日志：按序号分段，各线程把自己那一段格式化成文本，再按段号顺序输出
+    std::vector<std::string> details(scan_parallelism());
+    size_t parts = storage.scan_transactions(window, details.size(), [&](size_t part, const Transaction& trans) {
+        std::string& text = details[part];
+        text += "交易ID: " + trans.trans_id + '\n';
+        text += std::string("类型: ") + (trans.type == "buy" ? "销售" : "进货") + '\n';
+        text += "ISBN: " + trans.isbn + '\n';
+        text += "数量: " + std::to_string(trans.quantity) + '\n';
+        text += "单价: " + format_money(trans.price) + '\n';
+        text += "总额: " + format_money(trans.total) + '\n';
+        text += "用户: " + trans.user_id + '\n';
+        char time_buf[32];
+        text += "时间: ";
+        text.append(time_buf, format_time(trans.timestamp, time_buf));
+        text += '\n';
+        text += "---------------------------------------------\n";
+        return true;
+    });
+    for (size_t part = 0; part < parts; part++) {
+        output() << details[part];
+    }
+    // 合计只遍历类型与金额两列，同样分段求部分和再相加
+    const TransactionColumns& columns = storage.transaction_columns();
+    const std::vector<char>& types = columns.types();
+    const std::vector<long long>& totals = columns.totals();
+    const std::vector<long long>& timestamps = columns.timestamps();
+    std::pair<long long, long long> range = storage.transaction_seq_range(window);
+    size_t sum_parts = std::max<size_t>(1, std::min(scan_parallelism(), (size_t)((range.second - range.first) / (1 << 16))));
+    std::vector<std::pair<long long, long long>> sums(sum_parts, std::make_pair(0LL, 0LL));
+    run_parallel(sum_parts, [&](size_t part) {
+        size_t from = (size_t)part_begin(range.first, range.second, part, sum_parts);
+        size_t to = (size_t)part_begin(range.first, range.second, part + 1, sum_parts);
+        long long income = 0, expense = 0;
+        for (size_t i = from; i < to; i++) {
+            long long in_window = window.contains(timestamps[i]);
+            long long is_buy = types[i] == 'b';
+            income += totals[i] * is_buy * in_window;
+            expense += totals[i] * (1 - is_buy) * in_window;
+        }
+        sums[part] = std::make_pair(income, expense);
+    });
+    long long income = 0, expense = 0;
+    for (const auto& sum : sums) {
+        income += sum.first;
+        expense += sum.second;
+    }
+    Money total_income(income), total_expense(expense);
+    output() << "总收入: " << format_money(total_income) << '\n';
+    output() << "总支出: " << format_money(total_expense) << '\n';
+    output() << "净利润: " << format_money(total_income - total_expense) << '\n';
+    output() << "=============================================" << '\n';
+}
+static void format_employee(const TransactionColumns& columns, const User& user,
+                            const std::vector<long long>& seqs, std::string& text) {
+    text += "员工: " + user.name + " (" + user.id + ")" + '\n';
+    text += "权限: " + std::to_string(user.privilege) + '\n';
+    // 列式副本的第 seq 行即对应交易
+    if (!seqs.empty()) {
+        text += "交易记录:\n";
+        char time_buf[32];
+        for (long long seq : seqs) {
+            size_t i = (size_t)seq;
+            text += "  - ";
+            text.append(time_buf, format_time(columns.timestamps()[i], time_buf));
+            text += std::string(" ") + (columns.types()[i] == 'b' ? "销售" : "进货")
+                + " " + columns.isbn_dictionary().decode(columns.isbn_codes()[i])
+                + " 数量:" + std::to_string(columns.quantities()[i])
+                + " 总额:" + format_money(Money(columns.totals()[i])) + '\n';
         }
+    } else {
+        text += "暂无交易记录\n";
     }
-    std::cout << "总收入: " << format_double(total_income) << std::endl;
-    std::cout << "总支出: " << format_double(total_expense) << std::endl;
-    std::cout << "净利润: " << format_double(total_income - total_expense) << std::endl;
-    std::cout << "=============================================" << std::endl;
+    text += "---------------------------------------------\n";
 }
-void report_employee(Storage& storage, SystemState& state) {
-    std::vector<User> users = storage.get_all_users();
-    std::vector<Transaction> transactions = storage.get_all_transactions();
-    std::cout << "=============================================" << std::endl;
-    std::cout << "               员工工作报告" << endl;
-    std::cout << "=============================================" << std::endl;
-    std::map<std::string, std::vector<Transaction>> user_transactions;
-    for (const auto& trans : transactions) {
-        user_transactions[trans.user_id].push_back(trans);
+void report_employee(Storage& storage, const std::string& user_id) {
+    std::vector<User> users;
+    if (user_id.empty()) {
+        users = storage.get_all_users();
+    } else {
+        users.push_back(storage.load_user(user_id));
     }
+    std::vector<const User*> staff;
     for (const auto& user : users) {
         if (user.privilege >= 3) { // 只显示员工和店长
-            std::cout << "员工: " << user.name << " (" << user.id << ")" << std::endl;
-            std::cout << "权限: " << user.privilege << std::endl;
-            if (user_transactions.find(user.id) != user_transactions.end()) {
-                std::cout << "交易记录:" << std::endl;
-                for (const auto& trans : user_transactions[user.id]) {
-                    std::cout << "  - " << format_time(trans.timestamp)
-                         << " " << (trans.type == "buy" ? "销售" : "进货")
-                         << " " << trans.isbn
-                         << " 数量:" << trans.quantity
-                         << " 总额:" << format_double(trans.total) << std::endl;
-                }
-            } else {
-                std::cout << "暂无交易记录" << std::endl;
-            }
-            std::cout << "---------------------------------------------" << std::endl;
+            staff.push_back(&user);
         }
     }
-    std::cout << "=============================================" << std::endl;
+    output() << "=============================================" << '\n';
+    output() << "               员工工作报告" << '\n';
+    output() << "=============================================" << '\n';
+    std::unique_lock<std::recursive_mutex> lock = storage.lock_transactions();
+    // 只读取各员工自己的索引项；每个员工一节，多个线程轮流领取员工并行格式化，再按原顺序输出
+    std::vector<std::vector<long long>> seqs(staff.size());
+    for (size_t i = 0; i < staff.size(); i++) {
+        seqs[i] = storage.get_user_transaction_seqs(staff[i]->id);
+    }
+    const TransactionColumns& columns = storage.transaction_columns();
+    std::vector<std::string> sections(staff.size());
+    std::atomic<size_t> next(0);
+    run_parallel(std::min(scan_parallelism(), staff.size()), [&](size_t) {
+        size_t i;
+        while ((i = next++) < staff.size()) {
+            format_employee(columns, *staff[i], seqs[i], sections[i]);
+        }
+    });
+    for (const auto& section : sections) {
+        output() << section;
+    }
+    output() << "=============================================" << '\n';
 }
-void report_log(Storage& storage) {
-    std::vector<Transaction> transactions = storage.get_all_transactions();
-    std::cout << "=============================================" << std::endl;
-    std::cout << "                 系统日志" << std::endl;
-    std::cout << "=============================================" << std::endl;
-    if (transactions.empty()) {
-        std::cout << "暂无交易记录" << std::endl;
+void report_log(Storage& storage, const TimeWindow& window) {
+    std::unique_lock<std::recursive_mutex> lock = storage.lock_transactions();
+    const TransactionColumns& columns = storage.transaction_columns();
+    std::pair<long long, long long> range = storage.transaction_seq_range(window);
+    output() << "=============================================" << '\n';
+    output() << "                 系统日志" << '\n';
+    output() << "=============================================" << '\n';
+    bool any = false;
+    for (size_t i = (size_t)range.first; i < (size_t)range.second; i++) {
+        if (window.contains(columns.timestamps()[i])) {
+            any = true;
+            break;
+        }
+    }
+    if (!any) {
+        output() << "暂无交易记录" << '\n';
     } else {
-        for (const auto& trans : transactions) {
-            std::cout << format_time(trans.timestamp) << " "
-                 << "用户: " << trans.user_id << " "
-                 << (trans.type == "buy" ? "购买" : "进货") << " "
-                 << trans.isbn << " "
-                 << "数量: " << trans.quantity << " "
-                 << "总价: " << format_double(trans.total) << std::endl;
+        char time_buf[32];
+        for (size_t i = (size_t)range.first; i < (size_t)range.second; i++) {
+            if (!window.contains(columns.timestamps()[i])) continue;
+            output().write(time_buf, format_time(columns.timestamps()[i], time_buf));
+            output() << " "
+                << "用户: " << columns.user_dictionary().decode(columns.user_codes()[i]) << " "
+                << (columns.types()[i] == 'b' ? "购买" : "进货") << " "
+                << columns.isbn_dictionary().decode(columns.isbn_codes()[i]) << " "
+                << "数量: " << columns.quantities()[i] << " "
+                << "总价: " << format_money(Money(columns.totals()[i])) << '\n';
         }
     }
-    std::cout << "=============================================" << std::endl;
+    output() << "=============================================" << '\n';
 }
-// Created by Lenovo on 2025/12/13.
-//
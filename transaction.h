@@ -4,25 +4,48 @@
 #include <cstdint>
 #include "storage.h"
 #include "user.h"
+#include "money.h"
 
 struct Transaction{
     std::string trans_id;
     std::string type;
     std::string isbn;
     int quantity;
-    double price;
-    double total;
+    Money price;
+    Money total;
     std::string user_id;
     int64_t timestamp;
-    Transaction() : quantity(0), price(0.0), total(0.0), timestamp(0) {}
+    int64_t seq;    // 在交易日志中的序号
+    Transaction() : quantity(0), timestamp(0), seq(-1) {}
     bool valid() const {
         return !trans_id.empty() && !isbn.empty();
     }
 };
 
+// 单本书的累计销售与进货
+struct SalesStat{
+    std::string isbn;
+    long long units;
+    Money revenue;
+    long long import_units;
+    Money cost;
+    SalesStat() : units(0), import_units(0) {}
+};
+
+// 一天内的收支合计
+struct DailyStat{
+    std::string date;   // YYYY-MM-DD
+    Money income;
+    Money expense;
+};
+
 void show_finance(Storage& storage, int count = -1);
-void report_finance(Storage& storage);
-void report_employee(Storage& storage, SystemState& state);
-void report_log(Storage& storage);
+void show_finance(Storage& storage, const TimeWindow& window);
+void report_finance(Storage& storage, const TimeWindow& window = TimeWindow());
+void report_employee(Storage& storage, const std::string& user_id = "");
+void report_log(Storage& storage, const TimeWindow& window = TimeWindow());
+void report_bestseller(Storage& storage, int count);
+void report_sales(Storage& storage, const std::string& isbn);
+void report_daily(Storage& storage, const TimeWindow& window);
 
 #endif
@@ -8,6 +8,7 @@ bool register_user(Storage& storage, const std::string& user_id, const std::stri
     if (!valid_userid(user_id) || !valid_password(password) || user_name.empty()){
         return false;
     }
+    Storage::KeyGuard guard = storage.lock_key("user:" + user_id);
     User existing = storage.load_user(user_id);
     if (existing.valid()) return false;
 
@@ -24,6 +25,8 @@ bool login_user(Storage& storage, SystemState& state, const std::string& user_id
         return false;
     }
 
+    // 与删除用户互斥，避免登录一个正在被删除的用户
+    Storage::KeyGuard guard = storage.lock_key("user:" + user_id);
     User user = storage.load_user(user_id);
     if (!user.valid()) {
         return false;
@@ -55,6 +58,7 @@ bool logout_user(SystemState& state){
 bool change_password(Storage& storage, SystemState& state, const std::string& user_id, const std::string& old_password, const std::string& new_password){
     if (!valid_userid(user_id) || !valid_password(new_password)) return false;
 
+    Storage::KeyGuard guard = storage.lock_key("user:" + user_id);
     User user = storage.load_user(user_id);
     if (!user.valid()) return false;
 
@@ -76,6 +80,7 @@ bool add_user(Storage& storage, SystemState& state, const std::string& user_id,
     int current_priv = state.getCurrentPrivilege();
     if (current_priv <= privilege) return false;
 
+    Storage::KeyGuard guard = storage.lock_key("user:" + user_id);
     User existing = storage.load_user(user_id);
     if (existing.valid()) return false;
 
@@ -90,12 +95,11 @@ bool add_user(Storage& storage, SystemState& state, const std::string& user_id,
 bool delete_user(Storage& storage, SystemState& state, const std::string& user_id){
     if (state.getCurrentPrivilege() != 7) return false;
 
+    Storage::KeyGuard guard = storage.lock_key("user:" + user_id);
     User user = storage.load_user(user_id);
     if (!user.valid()) return false;
 
-    for (const auto& entry : state.login_stack){
-        if (entry.user_id == user_id) return false;
-    }
+    if (is_logged_in(user_id)) return false;
 
     return storage.delete_user(user_id);
 }
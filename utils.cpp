@@ -1,10 +1,12 @@
 #include "utils.h"
+#include "money.h"
 #include <cstring>
 #include <chrono>
 #include <random>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
 
 std::vector<std::string> split_string(const std::string& str, char delimiter){
     std::vector<std::string> result;
@@ -87,13 +89,8 @@ bool valid_keyword(const std::string& str){
 }
 
 bool valid_price(const std::string& str){
-    try{
-        double price = std::stod(str);
-        if (price < 0) return false;
-        return true;
-    } catch(...){
-        return false;
-    }
+    Money price;
+    return parse_money(str, price);
 }
 
 bool valid_quantity(const std::string& str){
@@ -106,28 +103,156 @@ bool valid_quantity(const std::string& str){
     }
 }
 
-std::string format_double(double value){
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(2) << value;
-    return ss.str();
+// 当前线程最近格式化过的那一天。[valid_from, valid_to) 内的时刻与当地零点 midnight 之差即为当天的秒数，
+// 日期部分直接复用，时分秒用整数运算得出，不再调用 localtime_r
+struct DayCache {
+    long long midnight;
+    long long valid_from;
+    long long valid_to;
+    char prefix[24];    // "YYYY-MM-DD "
+    int prefix_len;
+    DayCache() : midnight(0), valid_from(0), valid_to(0), prefix_len(0) {}
+};
+static thread_local DayCache day_cache;
+
+static bool load_day(long long seconds, DayCache& cache) {
+    time_t now = static_cast<time_t>(seconds);
+    tm timeinfo;
+    if (localtime_r(&now, &timeinfo) == nullptr) return false;
+    cache.prefix_len = (int)strftime(cache.prefix, sizeof(cache.prefix), "%Y-%m-%d ", &timeinfo);
+    cache.midnight = seconds - (timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec);
+    // 只有当天从 00:00:00 到 23:59:59 恰好 86400 秒（没有夏令时等偏移变化）时才缓存整天，否则只缓存这一秒
+    time_t first = static_cast<time_t>(cache.midnight);
+    time_t last = static_cast<time_t>(cache.midnight + 86399);
+    tm edge;
+    bool whole_day = localtime_r(&first, &edge) != nullptr && edge.tm_yday == timeinfo.tm_yday
+                     && edge.tm_hour == 0 && edge.tm_min == 0 && edge.tm_sec == 0
+                     && localtime_r(&last, &edge) != nullptr && edge.tm_yday == timeinfo.tm_yday
+                     && edge.tm_hour == 23 && edge.tm_min == 59 && edge.tm_sec == 59;
+    cache.valid_from = whole_day ? cache.midnight : seconds;
+    cache.valid_to = whole_day ? cache.midnight + 86400 : seconds + 1;
+    return true;
+}
+
+int format_time(long long timestamp, char* buf) {
+    long long seconds = timestamp / 1000000;
+    DayCache& cache = day_cache;
+    if (seconds < cache.valid_from || seconds >= cache.valid_to) {
+        if (!load_day(seconds, cache)) return 0;
+    }
+    memcpy(buf, cache.prefix, cache.prefix_len);
+    int of_day = (int)(seconds - cache.midnight);
+    int fields[3] = {of_day / 3600, of_day / 60 % 60, of_day % 60};
+    char* out = buf + cache.prefix_len;
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) *out++ = ':';
+        *out++ = (char)('0' + fields[i] / 10);
+        *out++ = (char)('0' + fields[i] % 10);
+    }
+    return (int)(out - buf);
 }
 
 std::string format_time(long long timestamp) {
-    time_t seconds = static_cast<time_t>(timestamp / 1000000);
-    tm* timeinfo = localtime(&seconds);
-    char buffer[80];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
-    return std::string(buffer);
+    char buf[32];
+    int len = format_time(timestamp, buf);
+    return std::string(buf, len);
+}
+
+// 定宽十六进制，字典序与数值序一致，用于拼接可排序的索引键
+std::string to_hex(unsigned long long value, int width) {
+    static const char digits[] = "0123456789abcdef";
+    std::string result(width, '0');
+    for (int i = width - 1; i >= 0; i--) {
+        result[i] = digits[value & 0xf];
+        value >>= 4;
+    }
+    return result;
+}
+
+// FNV-1a 64位哈希，输出定长16位十六进制，用于把任意长度的属性值压进定长索引键
+std::string hash_key(const std::string& str) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (unsigned char c : str) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return to_hex(h, 16);
+}
+
+std::string encode_cursor(const std::string& isbn) {
+    std::string cursor;
+    for (unsigned char c : isbn) {
+        cursor += to_hex(c, 2);
+    }
+    return cursor;
+}
+
+bool decode_cursor(const std::string& cursor, std::string& isbn) {
+    if (cursor.empty() || cursor.size() % 2 != 0) return false;
+    auto digit = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    isbn.clear();
+    for (size_t i = 0; i < cursor.size(); i += 2) {
+        int high = digit(cursor[i]), low = digit(cursor[i + 1]);
+        if (high < 0 || low < 0) return false;
+        isbn += static_cast<char>(high * 16 + low);
+    }
+    return valid_isbn(isbn);
+}
+
+bool parse_time(const std::string& str, bool range_end, long long& timestamp) {
+    auto digits = [&](size_t pos, size_t len, int& value) {
+        if (pos + len > str.size()) return false;
+        value = 0;
+        for (size_t i = pos; i < pos + len; i++) {
+            if (!std::isdigit(static_cast<unsigned char>(str[i]))) return false;
+            value = value * 10 + (str[i] - '0');
+        }
+        return true;
+    };
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    if (str.size() != 10 && str.size() != 19) return false;
+    if (!digits(0, 4, year) || str[4] != '-' || !digits(5, 2, month) || str[7] != '-' || !digits(8, 2, day)) {
+        return false;
+    }
+    bool has_clock = str.size() == 19;
+    if (has_clock) {
+        if (str[10] != 'T' || !digits(11, 2, hour) || str[13] != ':' || !digits(14, 2, minute)
+            || str[16] != ':' || !digits(17, 2, second)) {
+            return false;
+        }
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+    tm timeinfo = tm();
+    timeinfo.tm_year = year - 1900;
+    timeinfo.tm_mon = month - 1;
+    timeinfo.tm_mday = day;
+    timeinfo.tm_hour = hour;
+    timeinfo.tm_min = minute;
+    timeinfo.tm_sec = second;
+    timeinfo.tm_isdst = -1;
+    time_t seconds = mktime(&timeinfo);
+    if (seconds == (time_t)-1) return false;
+    timestamp = (long long)seconds * 1000000;
+    if (range_end) {
+        timestamp += has_clock ? 999999 : 86400LL * 1000000 - 1;
+    }
+    return true;
 }
 
 std::string generate_id() {
-    static int counter = 0;
+    static std::atomic<int> counter(0);
     return "ID" + std::to_string(time(nullptr)) + std::to_string(counter++);
 }
 
 std::string generate_trans_id() {
     using namespace std::chrono;
-    static uint64_t seq = 0;
+    static std::atomic<uint64_t> seq(0);
     auto micros = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
     std::ostringstream oss;
     oss << "TR" << micros << "_" << std::setw(12) << std::setfill('0') << seq++;
@@ -7,6 +7,7 @@
 #include <iomanip>
 #include <ctime>
 #include <cctype>
+#include <climits>
 
 std::vector<std::string> split_string(const std::string& str, char delimiter);
 std::vector<std::string> split_string_keep_empty(const std::string& str, char delimiter);
@@ -22,9 +23,37 @@ bool valid_keyword(const std::string& str);
 bool valid_price(const std::string& str);
 bool valid_quantity(const std::string& str);
 
-std::string format_double(double value);
+// 微秒时间戳按本地时间格式化为 YYYY-MM-DD HH:MM:SS。
+// 写入buf（至少32字节）的版本返回写入长度，不追加'\0'；同一天内的时刻不再查询时区，不分配内存，可在多个线程中同时调用
+int format_time(long long timestamp, char* buf);
 std::string format_time(long long timestamp);
 
+// 闭区间时间窗 [from, to]，单位为微秒，缺省时不限
+struct TimeWindow{
+    long long from;
+    long long to;
+    TimeWindow() : from(LLONG_MIN), to(LLONG_MAX) {}
+    bool unbounded() const { return from == LLONG_MIN && to == LLONG_MAX; }
+    bool contains(long long timestamp) const { return from <= timestamp && timestamp <= to; }
+};
+// 解析本地时间 YYYY-MM-DD 或 YYYY-MM-DDTHH:MM:SS；range_end 为真时取该日/该秒的最后一微秒
+bool parse_time(const std::string& str, bool range_end, long long& timestamp);
+
+std::string to_hex(unsigned long long value, int width);
+std::string hash_key(const std::string& str);
+
+// 按ISBN升序列出结果时的一页：跳过 ISBN <= after 的项（after 为空时不跳过），再跳过 offset 项，最多取 limit 项（< 0 时不限）
+struct PageRange{
+    std::string after;
+    long long offset;
+    long long limit;
+    PageRange() : offset(0), limit(-1) {}
+    bool unbounded() const { return after.empty() && offset == 0 && limit < 0; }
+};
+// 续页游标：把上一页最后一个ISBN编码成十六进制串，解码失败时返回false
+std::string encode_cursor(const std::string& isbn);
+bool decode_cursor(const std::string& cursor, std::string& isbn);
+
 std::string generate_id();
 std::string generate_trans_id();
 
@@ -0,0 +1,581 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <climits>
+#include <ftw.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "storage.h"
+#include "command.h"
+#include "output.h"
+#include "utils.h"
+
+// 合成负载：
+//   workload generate [--books=N] [--history=N] [--commands=N] [--users=N] [--staff=N]
+//                     [--zipf=S] [--seed=N] [--mix=su:4,show:50,buy:30,select:6,import:4,modify:6]
+//     向标准输出写一份命令流。同样的参数总是得到同样的命令流
+//   workload replay [--binary=路径] 命令流文件
+//     在临时目录中重放命令流，以 JSON 输出吞吐量与各类命令的延迟分布（纳秒）。
+//     不给 --binary 时直接调用链接进来的 execute()，否则启动该程序，从它的跟踪输出推算每条命令的耗时
+//
+// 命令流分两段：准备段建立用户、图书目录与历史交易，运行段才计入统计；两段以 "# run" 一行分隔
+
+// 全局 storage 构造时就会在当前目录打开数据文件，须在它之前切换到临时目录（同一文件内按定义顺序初始化）。
+// 命令行里的相对路径按原来的工作目录解析
+static std::string launch_dir;
+static std::string enter_scratch_directory(){
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) != nullptr) launch_dir = cwd;
+    const char* tmp = std::getenv("TMPDIR");
+    std::string pattern = std::string(tmp != nullptr && *tmp != '\0' ? tmp : "/tmp") + "/bookstore-workload-XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    if (mkdtemp(&path[0]) == nullptr || chdir(&path[0]) != 0){
+        std::cerr << "Fail to create scratch directory" << std::endl;
+        std::exit(1);
+    }
+    return std::string(&path[0]);
+}
+static std::string scratch_dir = enter_scratch_directory();
+Storage storage;
+
+static int remove_entry(const char* path, const struct stat*, int, struct FTW*){
+    return std::remove(path);
+}
+
+static int finish(int code){
+    nftw(scratch_dir.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return code;
+}
+
+static std::string resolve(const std::string& path){
+    if (path.empty() || path[0] == '/') return path;
+    return launch_dir + "/" + path;
+}
+
+// ---------------------------------------------------------------- 生成
+
+static const char* const OP_NAMES[] = {"su", "show", "buy", "select", "import", "modify"};
+enum Op{ OP_SU, OP_SHOW, OP_BUY, OP_SELECT, OP_IMPORT, OP_MODIFY, OP_COUNT };
+
+struct WorkloadConfig{
+    long long books;
+    long long history;
+    long long commands;
+    long long users;        // 顾客数，权限1
+    long long staff;        // 店员数，权限3
+    double zipf;
+    unsigned long long seed;
+    double mix[OP_COUNT];
+};
+
+// std::uniform_*_distribution 的结果因标准库实现而异，这里只用 mt19937_64 本身的输出，保证命令流可复现
+class Random{
+public:
+    explicit Random(unsigned long long seed) : engine(seed) {}
+    double uniform(){ return (engine() >> 11) * (1.0 / 9007199254740992.0); }
+    long long below(long long n){ return (long long)(engine() % (unsigned long long)n); }
+    long long between(long long low, long long high){ return low + below(high - low + 1); }
+private:
+    std::mt19937_64 engine;
+};
+
+// 排名 k（从0起）的概率正比于 1/(k+1)^s。排名再经一次打乱映射到图书，热门书分散在整个键空间
+class ZipfPicker{
+public:
+    ZipfPicker(long long n, double s, Random& random) : cdf(n), book_of_rank(n) {
+        double sum = 0;
+        for (long long k = 0; k < n; k++){
+            sum += 1.0 / std::pow((double)(k + 1), s);
+            cdf[k] = sum;
+        }
+        for (auto& value : cdf) value /= sum;
+        for (long long k = 0; k < n; k++) book_of_rank[k] = k;
+        for (long long k = n - 1; k > 0; k--) std::swap(book_of_rank[k], book_of_rank[random.below(k + 1)]);
+    }
+    long long pick(Random& random) const {
+        size_t rank = std::upper_bound(cdf.begin(), cdf.end(), random.uniform()) - cdf.begin();
+        return book_of_rank[std::min(rank, cdf.size() - 1)];
+    }
+private:
+    std::vector<double> cdf;
+    std::vector<long long> book_of_rank;
+};
+
+static std::string workload_isbn(long long book){
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "978-7-%07lld", book);
+    return buf;
+}
+
+static std::string workload_name(long long book){ return "Title" + std::to_string(book); }
+static std::string workload_author(long long book, long long books){ return "Author" + std::to_string(book % (books / 10 + 1)); }
+static std::string workload_keyword(long long book){ return "kw" + std::to_string(book % 50); }
+
+static std::string workload_price(Random& random){
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%lld.%02lld", random.between(5, 199), random.below(100));
+    return buf;
+}
+
+// 运行段中登录栈底是 root，其上至多一个顾客或店员；选中的图书随登录一起切换
+class WorkloadWriter{
+public:
+    WorkloadWriter(const WorkloadConfig& c, std::ostream& o)
+        : config(c), out(o), random(c.seed), zipf(c.books, c.zipf, random), level(7), selected(false), remaining(0) {}
+
+    void write(){
+        out << "# bookstore workload books=" << config.books << " history=" << config.history
+            << " commands=" << config.commands << " zipf=" << config.zipf << " seed=" << config.seed << "\n";
+        setup();
+        out << "# run\n";
+        run();
+    }
+
+private:
+    const WorkloadConfig& config;
+    std::ostream& out;
+    Random random;
+    ZipfPicker zipf;
+    int level;          // 当前登录者的权限
+    bool selected;      // 当前登录者是否已选中图书
+    long long remaining;
+
+    void setup(){
+        out << "su root sjtu\n";
+        for (long long i = 0; i < config.staff; i++){
+            out << "useradd staff" << i << " pw" << i << " 3 Staff" << i << "\n";
+        }
+        for (long long i = 0; i < config.users; i++){
+            out << "useradd user" << i << " pw" << i << " 1 User" << i << "\n";
+        }
+        // 库存给足，运行段的购买不会因缺货失败
+        for (long long book = 0; book < config.books; book++){
+            out << "select " << workload_isbn(book) << "\n";
+            out << "modify -name=\"" << workload_name(book) << "\" -author=\"" << workload_author(book, config.books)
+                << "\" -keyword=\"" << workload_keyword(book) << "|genre" << book % 7
+                << "\" -price=" << workload_price(random) << "\n";
+            out << "import 1000000 " << random.between(1000, 100000) << ".00\n";
+        }
+        for (long long i = 0; i < config.history; i++){
+            out << "buy " << workload_isbn(zipf.pick(random)) << " " << random.between(1, 3) << "\n";
+        }
+    }
+
+    // 运行段还能写出的命令数；logout 与自动插入的 su、select 都计入 --commands
+    bool spend(){
+        if (remaining == 0) return false;
+        remaining--;
+        return true;
+    }
+
+    // 换人登录，写出 logout（栈顶不是 root 时）与 su；命令数用完时返回 false
+    bool login(bool as_staff){
+        if (level != 7){
+            if (!spend()) return false;
+            out << "logout\n";
+            level = 7;
+            selected = false;
+        }
+        if (!spend()) return false;
+        long long id = as_staff ? random.below(config.staff) : random.below(config.users);
+        out << "su " << (as_staff ? "staff" : "user") << id << " pw" << id << "\n";
+        level = as_staff ? 3 : 1;
+        return true;
+    }
+
+    void run(){
+        double total = 0;
+        double back_office = config.mix[OP_SELECT] + config.mix[OP_IMPORT] + config.mix[OP_MODIFY];
+        double other = config.mix[OP_SHOW] + config.mix[OP_BUY] + back_office;
+        for (int op = 0; op < OP_COUNT; op++) total += config.mix[op];
+        remaining = config.commands;
+        while (remaining > 0){
+            double u = random.uniform() * total;
+            int op = 0;
+            while (op < OP_COUNT - 1 && u >= config.mix[op]){
+                u -= config.mix[op];
+                op++;
+            }
+            if (op == OP_SU){
+                login(random.uniform() * other < back_office);
+                continue;
+            }
+            bool needs_staff = op == OP_SELECT || op == OP_IMPORT || op == OP_MODIFY;
+            // 顾客登录时抽到店员的操作，先换成店员登录
+            if (needs_staff && level < 3 && !login(true)) break;
+            if (!spend()) break;
+            if ((op == OP_IMPORT || op == OP_MODIFY) && !selected) op = OP_SELECT;
+            long long book = zipf.pick(random);
+            switch (op){
+                case OP_SHOW: {
+                    long long kind = random.below(10);
+                    if (kind < 7) out << "show -ISBN=" << workload_isbn(book) << "\n";
+                    else if (kind == 7) out << "show -name=\"" << workload_name(book) << "\"\n";
+                    else if (kind == 8) out << "show -author=\"" << workload_author(book, config.books) << "\"\n";
+                    else out << "show -keyword=\"" << workload_keyword(book) << "\"\n";
+                    break;
+                }
+                case OP_BUY:
+                    out << "buy " << workload_isbn(book) << " " << random.between(1, 3) << "\n";
+                    break;
+                case OP_SELECT:
+                    out << "select " << workload_isbn(book) << "\n";
+                    selected = true;
+                    break;
+                case OP_IMPORT:
+                    out << "import " << random.between(1, 50) << " " << random.between(10, 5000) << ".00\n";
+                    break;
+                case OP_MODIFY:
+                    if (random.below(5) == 0) {
+                        out << "modify -keyword=\"kw" << random.below(50) << "|genre" << random.below(7) << "\"\n";
+                    } else {
+                        out << "modify -price=" << workload_price(random) << "\n";
+                    }
+                    break;
+            }
+        }
+    }
+};
+
+static bool parse_mix(const std::string& text, double* mix){
+    for (int op = 0; op < OP_COUNT; op++) mix[op] = 0;
+    double total = 0;
+    for (const auto& item : split_string(text, ',')){
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) return false;
+        std::string name = item.substr(0, colon);
+        int op = 0;
+        while (op < OP_COUNT && name != OP_NAMES[op]) op++;
+        if (op == OP_COUNT) return false;
+        mix[op] = std::atof(item.c_str() + colon + 1);
+        if (mix[op] < 0) return false;
+        total += mix[op];
+    }
+    return total > 0;
+}
+
+static int generate(int argc, char** argv){
+    WorkloadConfig config;
+    config.books = 10000;
+    config.history = 50000;
+    config.commands = 100000;
+    config.users = 100;
+    config.staff = 10;
+    config.zipf = 0.99;
+    config.seed = 1;
+    parse_mix("su:4,show:50,buy:30,select:6,import:4,modify:6", config.mix);
+    for (int i = 2; i < argc; i++){
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        bool ok = !value.empty();
+        if (key == "--books") config.books = std::atoll(value.c_str());
+        else if (key == "--history") config.history = std::atoll(value.c_str());
+        else if (key == "--commands") config.commands = std::atoll(value.c_str());
+        else if (key == "--users") config.users = std::atoll(value.c_str());
+        else if (key == "--staff") config.staff = std::atoll(value.c_str());
+        else if (key == "--zipf") config.zipf = std::atof(value.c_str());
+        else if (key == "--seed") config.seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (key == "--mix") ok = ok && parse_mix(value, config.mix);
+        else ok = false;
+        if (!ok){
+            std::cerr << "Invalid option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (config.books < 1 || config.users < 1 || config.staff < 1 || config.history < 0
+        || config.commands < 0 || config.zipf < 0){
+        std::cerr << "Invalid workload size" << std::endl;
+        return 1;
+    }
+    std::ios::sync_with_stdio(false);
+    WorkloadWriter(config, std::cout).write();
+    std::cout.flush();
+    return std::cout ? 0 : 1;
+}
+
+// ---------------------------------------------------------------- 重放
+
+typedef std::chrono::steady_clock Clock;
+
+static long long elapsed_ns(Clock::time_point begin, Clock::time_point end){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+}
+
+// 一类命令的延迟：保存全部样本算分位数，另按2的幂分桶给出直方图
+struct LatencyStats{
+    std::string type;
+    std::vector<long long> samples;
+    long long failed;
+    LatencyStats() : failed(0) {}
+};
+
+struct ReplayResult{
+    std::string mode;
+    long long setup_ns;
+    long long run_ns;
+    std::vector<LatencyStats> types;
+
+    ReplayResult() : setup_ns(0), run_ns(0) {}
+
+    LatencyStats& stats(const std::string& type){
+        for (auto& entry : types){
+            if (entry.type == type) return entry;
+        }
+        types.push_back(LatencyStats());
+        types.back().type = type;
+        return types.back();
+    }
+};
+
+static std::string command_type(const std::string& line){
+    size_t begin = line.find_first_not_of(' ');
+    if (begin == std::string::npos) return "empty";
+    size_t end = line.find(' ', begin);
+    return line.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+static long long percentile(const std::vector<long long>& sorted, double p){
+    if (sorted.empty()) return 0;
+    size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static void print_result(ReplayResult& result){
+    long long commands = 0;
+    for (const auto& entry : result.types) commands += (long long)entry.samples.size();
+    double seconds = result.run_ns / 1e9;
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "{\n  \"mode\": \"%s\",\n  \"setup_seconds\": %.3f,\n  \"run_seconds\": %.3f,\n"
+                  "  \"commands\": %lld,\n  \"commands_per_sec\": %.1f,\n  \"types\": [",
+                  result.mode.c_str(), result.setup_ns / 1e9, seconds, commands,
+                  seconds > 0 ? commands / seconds : 0.0);
+    std::cout << line;
+    std::sort(result.types.begin(), result.types.end(), [](const LatencyStats& a, const LatencyStats& b){
+        return a.samples.size() > b.samples.size();
+    });
+    for (size_t i = 0; i < result.types.size(); i++){
+        LatencyStats& entry = result.types[i];
+        std::vector<long long> sorted = entry.samples;
+        std::sort(sorted.begin(), sorted.end());
+        long long total = 0;
+        for (long long ns : sorted) total += ns;
+        std::snprintf(line, sizeof(line),
+                      "%s\n    {\"type\": \"%s\", \"count\": %zu, \"failed\": %lld, \"mean_ns\": %lld, "
+                      "\"p50_ns\": %lld, \"p90_ns\": %lld, \"p99_ns\": %lld, \"p999_ns\": %lld, \"max_ns\": %lld,\n"
+                      "     \"histogram\": [",
+                      i == 0 ? "" : ",", entry.type.c_str(), sorted.size(), entry.failed,
+                      sorted.empty() ? 0 : total / (long long)sorted.size(),
+                      percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99),
+                      percentile(sorted, 0.999), sorted.empty() ? 0 : sorted.back());
+        std::cout << line;
+        // 桶 k 统计 [2^k, 2^(k+1)) 纳秒的样本，只列出非空的桶
+        std::vector<long long> buckets(64, 0);
+        for (long long ns : sorted){
+            int k = 0;
+            while (k < 62 && (ns >> (k + 1)) > 0) k++;
+            buckets[k]++;
+        }
+        bool first = true;
+        for (int k = 0; k < 64; k++){
+            if (buckets[k] == 0) continue;
+            std::snprintf(line, sizeof(line), "%s{\"below_ns\": %lld, \"count\": %lld}",
+                          first ? "" : ", ", 1LL << (k + 1), buckets[k]);
+            std::cout << line;
+            first = false;
+        }
+        std::cout << "]}";
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+}
+
+// 读入命令流，按 "# run" 分为准备段与运行段，其余以 # 开头的行是注释
+static bool load_workload(const std::string& path, std::vector<std::string>& setup, std::vector<std::string>& run){
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    bool running = false;
+    while (getline(in, line)){
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty() && line[0] == '#'){
+            if (line == "# run") running = true;
+            continue;
+        }
+        (running ? run : setup).push_back(line);
+    }
+    return true;
+}
+
+// 链接进来的 execute()：逐条计时，输出照常格式化后写到 /dev/null
+static bool replay_linked(const std::vector<std::string>& setup, const std::vector<std::string>& run,
+                          ReplayResult& result){
+    if (!storage.initialize()) return false;
+    FILE* sink = std::fopen("/dev/null", "w");
+    if (sink == nullptr) return false;
+    OutputBuffer out(sink);
+    set_output(&out);
+    SystemState state;
+    register_session(&state);
+    ParsedCommand cmd;
+    Clock::time_point begin = Clock::now();
+    for (const auto& line : setup){
+        cmd.line = line;
+        parse_command(cmd);
+        execute(cmd, state);
+    }
+    Clock::time_point run_begin = Clock::now();
+    result.setup_ns = elapsed_ns(begin, run_begin);
+    for (const auto& line : run){
+        if (state.should_exit) break;
+        Clock::time_point start = Clock::now();
+        cmd.line = line;
+        parse_command(cmd);
+        bool success = execute(cmd, state);
+        long long ns = elapsed_ns(start, Clock::now());
+        LatencyStats& stats = result.stats(command_type(line));
+        stats.samples.push_back(ns);
+        if (!success) stats.failed++;
+    }
+    result.run_ns = elapsed_ns(run_begin, Clock::now());
+    unregister_session(&state);
+    out.flush();
+    set_output(nullptr);
+    std::fclose(sink);
+    return true;
+}
+
+// 外部程序：打开 BOOKSTORE_TRACE，它每执行完一条命令就向标准错误写一行跟踪。
+// 命令提前整批写入，程序不会等输入，相邻两行跟踪的间隔就是后一条命令的耗时（含跟踪输出本身）
+static bool replay_binary(const std::string& binary, const std::vector<std::string>& setup,
+                          const std::vector<std::string>& run, ReplayResult& result){
+    std::string work_dir = scratch_dir + "/binary";
+    if (mkdir(work_dir.c_str(), 0700) != 0) return false;
+    int input[2], trace[2];
+    if (pipe(input) != 0) return false;
+    if (pipe(trace) != 0){
+        close(input[0]);
+        close(input[1]);
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0){
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (chdir(work_dir.c_str()) != 0 || null_fd < 0) _exit(127);
+        dup2(input[0], 0);
+        dup2(null_fd, 1);
+        dup2(trace[1], 2);
+        close(input[0]);
+        close(input[1]);
+        close(trace[0]);
+        close(trace[1]);
+        close(null_fd);
+        setenv("BOOKSTORE_TRACE", "1", 1);
+        setenv("BOOKSTORE_FLUSH", "batch", 1);
+        execl(binary.c_str(), binary.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    close(input[0]);
+    close(trace[1]);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Clock::time_point begin = Clock::now();
+    std::thread writer([&](){
+        std::string text;
+        for (const auto& line : setup) text += line + "\n";
+        for (const auto& line : run) text += line + "\n";
+        size_t done = 0;
+        while (done < text.size()){
+            ssize_t n = write(input[1], text.data() + done, text.size() - done);
+            if (n <= 0) break;
+            done += (size_t)n;
+        }
+        close(input[1]);
+    });
+
+    // 第 n 行跟踪对应第 n 条命令；程序提前退出（quit）时后面的命令没有跟踪
+    FILE* stream = fdopen(trace[0], "r");
+    Clock::time_point previous = begin;
+    Clock::time_point run_begin = begin;
+    size_t line_no = 0;
+    char* buf = nullptr;
+    size_t capacity = 0;
+    while (stream != nullptr && getline(&buf, &capacity, stream) >= 0){
+        if (std::strncmp(buf, "[TRACE] #", 9) != 0) continue;
+        Clock::time_point now = Clock::now();
+        line_no++;
+        if (line_no == setup.size()){
+            run_begin = now;
+        } else if (line_no > setup.size() && line_no - setup.size() <= run.size()){
+            const std::string& line = run[line_no - setup.size() - 1];
+            LatencyStats& stats = result.stats(command_type(line));
+            stats.samples.push_back(elapsed_ns(previous, now));
+            if (std::strstr(buf, "\" result=FAIL ") != nullptr) stats.failed++;
+        }
+        previous = now;
+    }
+    std::free(buf);
+    if (setup.empty()) run_begin = begin;
+    result.setup_ns = elapsed_ns(begin, run_begin);
+    result.run_ns = elapsed_ns(run_begin, previous);
+    if (stream != nullptr) std::fclose(stream);
+    else close(trace[0]);
+    writer.join();
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        std::cerr << "Replayed program exited abnormally" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static int replay(int argc, char** argv){
+    std::string binary;
+    std::string path;
+    for (int i = 2; i < argc; i++){
+        std::string arg = argv[i];
+        if (arg.compare(0, 9, "--binary=") == 0) binary = resolve(arg.substr(9));
+        else if (path.empty() && arg.compare(0, 2, "--") != 0) path = resolve(arg);
+        else {
+            std::cerr << "Invalid option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    std::vector<std::string> setup, run;
+    if (path.empty() || !load_workload(path, setup, run)){
+        std::cerr << "Fail to read workload" << std::endl;
+        return 1;
+    }
+    ReplayResult result;
+    result.mode = binary.empty() ? "linked" : "binary";
+    bool ok = binary.empty() ? replay_linked(setup, run, result) : replay_binary(binary, setup, run, result);
+    if (!ok) return 1;
+    print_result(result);
+    return 0;
+}
+
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "generate") return finish(generate(argc, argv));
+    if (mode == "replay") return finish(replay(argc, argv));
+    std::cerr << "Usage: " << argv[0] << " generate [--books=N] [--history=N] [--commands=N] [--users=N] [--staff=N]"
+              << " [--zipf=S] [--seed=N] [--mix=su:4,show:50,buy:30,select:6,import:4,modify:6]\n"
+              << "       " << argv[0] << " replay [--binary=PATH] WORKLOAD" << std::endl;
+    return finish(1);
+}